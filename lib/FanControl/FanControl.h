@@ -0,0 +1,271 @@
+#pragma once
+#include <stdint.h>
+
+// Fan control law in fixed point. Temperatures are in centi-degrees C and
+// rates in centi-degrees C per minute. Nothing here touches the hardware, so
+// the host simulation in tools/sim runs the same code as the firmware.
+
+#define RATE_HISTORY 4              // readings spanned by one slope estimate
+#define FEED_FORWARD_DEADBAND 50    // slower rises (0.5 C/min) are drift
+#define FEED_FORWARD_MAX 1000       // look-ahead never adds more than 10 C
+
+// Filtered rate of change of one sensor: the slope across the last
+// RATE_HISTORY readings, smoothed by an exponential average (1/4 weight).
+class RateFilter {
+    int16_t temps[RATE_HISTORY];
+    uint32_t stamps[RATE_HISTORY];
+    uint8_t count;
+    uint8_t next;
+    int16_t rate;
+
+public:
+    RateFilter() {
+        reset();
+    }
+
+    void reset()
+    {
+        count = 0;
+        next = 0;
+        rate = 0;
+    }
+
+    void update(int16_t temp, uint32_t now)
+    {
+        // the oldest reading is overwritten by this one
+        int16_t oldTemp = temps[next];
+        uint32_t oldStamp = stamps[next];
+        temps[next] = temp;
+        stamps[next] = now;
+        next = (next + 1) % RATE_HISTORY;
+        if (count < RATE_HISTORY) {
+            count++;
+            return;
+        }
+        uint32_t elapsed = now - oldStamp;
+        if (elapsed == 0) return;
+        int32_t slope = (int32_t)(temp - oldTemp) * 60000 / (int32_t)elapsed;
+        if (slope > INT16_MAX) slope = INT16_MAX;
+        if (slope < INT16_MIN) slope = INT16_MIN;
+        rate += (slope - rate) / 4;
+    }
+
+    int16_t value() const
+    {
+        return rate;
+    }
+};
+
+// temperature offset that makes the fans react to where a fast rise is
+// heading: rate times the look-ahead time, nothing for drift or cooling
+inline int16_t feedForward(int16_t rate, uint16_t lookAheadSeconds)
+{
+    if (rate <= FEED_FORWARD_DEADBAND) return 0;
+    int32_t offset = (int32_t)rate * lookAheadSeconds / 60;
+    return offset > FEED_FORWARD_MAX ? FEED_FORWARD_MAX : offset;
+}
+
+// duty cycle for a temperature: off below threshold - hysteresis, then
+// rising linearly from minDuty to maxDuty at the threshold
+inline uint8_t fanDutyCycle(int16_t temp, uint8_t threshold, uint8_t hysteresis, uint8_t minDuty, uint8_t maxDuty)
+{
+    int32_t low = ((int32_t)threshold - hysteresis) * 100;
+    int32_t high = (int32_t)threshold * 100;
+    if (temp < low) return 0;
+    if (temp >= high) return maxDuty;
+    return minDuty + (temp - low) * (maxDuty - minDuty) / (high - low);
+}
+
+// whether fanDutyCycle() gets a band it can use: the fans start below the
+// threshold, not below 0 C
+inline bool fanBandValid(uint8_t threshold, uint8_t hysteresis)
+{
+    return hysteresis <= threshold;
+}
+
+// Relay-feedback (Astrom-Hagglund) experiment: the fans are switched between
+// stopped and the relay duty as the temperature crosses the setpoint, which
+// makes the enclosure oscillate at its ultimate period. The amplitude of the
+// oscillation gives the ultimate gain, 4 d / (pi a) for a relay of amplitude d.
+#define RELAY_TUNE_BAND 25          // switches 0.25 C either side of the setpoint
+#define RELAY_TUNE_SETTLE 1         // cycles left out while the oscillation settles
+#define RELAY_TUNE_CYCLES 3         // cycles averaged
+#define RELAY_TUNE_GAIN_PERCENT 25  // proportional gain, of the ultimate gain
+#define RELAY_TUNE_LOOK_AHEAD_DIV 8 // look-ahead (derivative time), of the period
+
+#define RELAY_TUNE_IDLE 0
+#define RELAY_TUNE_RUNNING 1
+#define RELAY_TUNE_DONE 2
+#define RELAY_TUNE_OVER_LIMIT 3     // the temperature reached the safety limit
+#define RELAY_TUNE_TIMED_OUT 4      // no steady oscillation in time
+#define RELAY_TUNE_ABORTED 5        // by the master or a sensor fault
+
+class RelayTune {
+    int16_t setpoint;
+    int16_t limit;
+    uint8_t relayDuty;
+    uint32_t started;
+    uint32_t timeout;
+    bool cooling;
+    uint8_t rises;              // setpoint crossings upwards
+    uint32_t lastRise;
+    int16_t high;               // extremes since the last rise
+    int16_t low;
+    uint32_t periodSum;         // ms, over the measured cycles
+    uint32_t swingSum;          // peak to peak, over the measured cycles
+
+    static uint16_t isqrt(uint32_t value)
+    {
+        uint32_t root = 0;
+        for (uint32_t bit = 1UL << 30; bit; bit >>= 2) {
+            if (value >= root + bit) {
+                value -= root + bit;
+                root = (root >> 1) + bit;
+            } else {
+                root >>= 1;
+            }
+        }
+        return root;
+    }
+
+    void finish()
+    {
+        ultimatePeriod = periodSum / RELAY_TUNE_CYCLES / 1000;
+        amplitude = swingSum / RELAY_TUNE_CYCLES / 2;
+        // the relay band delays the switching, a sqrt(a^2 - e^2) corrects it
+        uint32_t a = amplitude;
+        uint16_t root = a > RELAY_TUNE_BAND ? isqrt(a * a - (uint32_t)RELAY_TUNE_BAND * RELAY_TUNE_BAND) : 1;
+        // 4 * (relayDuty / 2) / (pi * root / 100), pi as 3142 / 1000
+        ultimateGain = 200000UL * relayDuty / (3142UL * (root ? root : 1));
+        state = RELAY_TUNE_DONE;
+    }
+
+public:
+    uint8_t state = RELAY_TUNE_IDLE;
+    uint8_t cycles = 0;         // completed, settling ones included
+    uint16_t ultimateGain = 0;  // duty counts per C
+    uint16_t ultimatePeriod = 0; // s
+    uint16_t amplitude = 0;     // of the temperature oscillation
+
+    void start(int16_t setpoint, int16_t limit, uint8_t relayDuty, uint32_t now, uint32_t timeout)
+    {
+        this->setpoint = setpoint;
+        this->limit = limit;
+        this->relayDuty = relayDuty;
+        this->timeout = timeout;
+        started = now;
+        cooling = false;
+        rises = 0;
+        high = INT16_MIN;
+        low = INT16_MAX;
+        periodSum = 0;
+        swingSum = 0;
+        cycles = 0;
+        // nothing measured yet, not the previous run's result
+        ultimateGain = 0;
+        ultimatePeriod = 0;
+        amplitude = 0;
+        state = RELAY_TUNE_RUNNING;
+    }
+
+    void abort()
+    {
+        if (state == RELAY_TUNE_RUNNING) state = RELAY_TUNE_ABORTED;
+    }
+
+    bool running() const
+    {
+        return state == RELAY_TUNE_RUNNING;
+    }
+
+    // duty cycle for the next period; the experiment ends when the state
+    // changes, the fans are then left at the relay duty
+    uint8_t update(int16_t temp, uint32_t now)
+    {
+        if (state != RELAY_TUNE_RUNNING) return relayDuty;
+        if (temp >= limit) {
+            state = RELAY_TUNE_OVER_LIMIT;
+            return relayDuty;
+        }
+        if (now - started > timeout) {
+            state = RELAY_TUNE_TIMED_OUT;
+            return relayDuty;
+        }
+        if (temp > high) high = temp;
+        if (temp < low) low = temp;
+
+        if (cooling && temp < setpoint - RELAY_TUNE_BAND) {
+            cooling = false;
+        } else if (!cooling && temp > setpoint + RELAY_TUNE_BAND) {
+            cooling = true;
+            if (rises > 0) {
+                // a whole cycle since the last rise
+                if (cycles >= RELAY_TUNE_SETTLE) {
+                    periodSum += now - lastRise;
+                    swingSum += high - low;
+                }
+                cycles++;
+            }
+            if (rises < UINT8_MAX) rises++;
+            lastRise = now;
+            high = temp;
+            low = temp;
+            if (cycles == RELAY_TUNE_SETTLE + RELAY_TUNE_CYCLES) finish();
+        }
+        return cooling ? relayDuty : 0;
+    }
+};
+
+// settings for the measured ultimate gain and period: the band gives the
+// control law RELAY_TUNE_GAIN_PERCENT of the ultimate gain, the look-ahead
+// acts as derivative time
+inline uint8_t relayTuneHysteresis(uint16_t ultimateGain, uint8_t minDuty, uint8_t maxDuty)
+{
+    uint32_t gain = (uint32_t)ultimateGain * RELAY_TUNE_GAIN_PERCENT;
+    if (gain == 0) return UINT8_MAX;
+    uint32_t band = ((uint32_t)(maxDuty - minDuty) * 100 + gain - 1) / gain;
+    return band < 1 ? 1 : band > UINT8_MAX ? UINT8_MAX : band;
+}
+
+inline uint16_t relayTuneLookAhead(uint16_t ultimatePeriod)
+{
+    return ultimatePeriod / RELAY_TUNE_LOOK_AHEAD_DIV;
+}
+
+inline uint8_t fanPercent(uint8_t dutyCycle, uint8_t minDuty, uint8_t maxDuty)
+{
+    if (dutyCycle < minDuty) return 0;
+    return (uint16_t)(dutyCycle - minDuty) * 100 / (maxDuty - minDuty);
+}
+
+// Usage counters of one fan channel, integrated on every control tick
+struct FanUsage
+{
+    uint32_t runtime;           // s with the fan turning
+    uint32_t dutyRuntime;       // s of full speed equivalent, duty weighted
+    uint32_t fullSpeedTime;     // s at maximum duty
+    uint32_t faultEvents;       // times a sensor fault forced full speed
+    // remainders below one second, carried to the next tick
+    uint16_t runtimeMs;
+    uint16_t fullSpeedMs;
+    uint32_t dutyMs;            // duty * ms, below maxDuty * 1000
+};
+
+inline void fanUsageUpdate(FanUsage &usage, uint8_t dutyCycle, uint8_t maxDuty, uint16_t elapsedMs)
+{
+    if (dutyCycle == 0) return;
+
+    usage.runtimeMs += elapsedMs;
+    usage.runtime += usage.runtimeMs / 1000;
+    usage.runtimeMs %= 1000;
+
+    usage.dutyMs += (uint32_t)dutyCycle * elapsedMs;
+    usage.dutyRuntime += usage.dutyMs / (maxDuty * 1000UL);
+    usage.dutyMs %= maxDuty * 1000UL;
+
+    if (dutyCycle >= maxDuty) {
+        usage.fullSpeedMs += elapsedMs;
+        usage.fullSpeedTime += usage.fullSpeedMs / 1000;
+        usage.fullSpeedMs %= 1000;
+    }
+}
@@ -0,0 +1,46 @@
+#include "MemoryStats.h"
+
+// set by the avr-libc linker script and malloc
+extern char __heap_start;
+extern char *__brkval;
+
+// paints _end up to __stack from .init1, before the stack pointer and r1 are
+// set up, so it is naked and only touches Z, r24 and r25
+__attribute__((naked, used, section(".init1"))) static void memoryPaintStack(void)
+{
+    __asm volatile(
+        "    ldi r30, lo8(_end)\n"
+        "    ldi r31, hi8(_end)\n"
+        "    ldi r24, %0\n"
+        "    ldi r25, hi8(__stack)\n"
+        "    rjmp 2f\n"
+        "1:  st Z+, r24\n"
+        "2:  cpi r30, lo8(__stack)\n"
+        "    cpc r31, r25\n"
+        "    brlo 1b\n"
+        "    breq 1b\n"
+        :: "M" (MEMORY_CANARY));
+}
+
+static const uint8_t *heapEnd(void)
+{
+    return __brkval ? (const uint8_t *)__brkval : (const uint8_t *)&__heap_start;
+}
+
+uint16_t memoryStackHeadroom(void)
+{
+    uint8_t top;
+    const uint8_t *p = heapEnd();
+    uint16_t headroom = 0;
+    while (p < &top && *p == MEMORY_CANARY) {
+        p++;
+        headroom++;
+    }
+    return headroom;
+}
+
+uint16_t memoryFree(void)
+{
+    uint8_t top;
+    return &top - heapEnd();
+}
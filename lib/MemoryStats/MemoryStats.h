@@ -0,0 +1,15 @@
+#pragma once
+#include <stdint.h>
+
+// SRAM headroom. The RAM between the static data and the top of the stack is
+// painted with MEMORY_CANARY before the C runtime starts; bytes still holding
+// it were never reached by the stack or the heap, so the deepest stack use
+// since reset can be read back at any time.
+
+#define MEMORY_CANARY 0xc5
+
+// bytes between the heap and the deepest point the stack has reached
+uint16_t memoryStackHeadroom(void);
+
+// bytes between the heap and the current stack pointer
+uint16_t memoryFree(void);
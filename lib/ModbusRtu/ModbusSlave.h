@@ -0,0 +1,285 @@
+#pragma once
+#include <stdint.h>
+#include "RegisterMap.h"
+
+// Modbus RTU slave protocol handling. It works on complete frames handed
+// over by the transport (RtuFramer on the board) and does not touch any
+// hardware, so it builds for the host as well. Registers are served straight
+// from the variables bound in the holding and input register maps.
+
+#define MODBUS_BROADCAST_ADDRESS 0
+// addresses 248..255 are reserved by the spec, they address groups 1..8
+#define MODBUS_GROUP_ADDRESS_BASE 247
+#define MODBUS_MAX_GROUP 8
+#define MODBUS_MIN_FRAME 4
+
+#define MODBUS_FC_READ_HOLDING_REGISTERS 0x03
+#define MODBUS_FC_READ_INPUT_REGISTERS 0x04
+#define MODBUS_FC_WRITE_SINGLE_REGISTER 0x06
+#define MODBUS_FC_WRITE_MULTIPLE_REGISTERS 0x10
+#define MODBUS_FC_READ_WRITE_MULTIPLE_REGISTERS 0x17
+
+#define MODBUS_EXCEPTION_ILLEGAL_FUNCTION 0x01
+#define MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS 0x02
+#define MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE 0x03
+
+inline uint16_t modbusCrc(const uint8_t *data, uint8_t length)
+{
+    uint16_t crc = 0xffff;
+    while (length--) {
+        crc ^= *data++;
+        for (uint8_t i = 0; i < 8; i++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xa001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+class ModbusSlave {
+    uint8_t address;
+    uint8_t group;
+    uint8_t writeFlags;
+    const RegisterDef *holding;
+    uint8_t holdingCount;
+    const RegisterDef *input;
+    uint8_t inputCount;
+    // the registers being written, while their values are checked and stored
+    uint16_t writeStart;
+    uint16_t writeCount;
+    const uint8_t *writeValues;
+
+    static uint16_t word(const uint8_t *p)
+    {
+        return ((uint16_t)p[0] << 8) | p[1];
+    }
+
+    // the exception PDU: the function code with the high bit set and the code
+    static uint8_t exception(uint8_t *response, uint8_t code)
+    {
+        response[1] |= 0x80;
+        response[2] = code;
+        return 2;
+    }
+
+    // index of the map entry for start if the map covers start..start+count-1
+    // without gaps, -1 otherwise
+    int find(const RegisterDef *map, uint8_t mapCount, uint16_t start, uint16_t count)
+    {
+        RegisterDef def;
+        for (uint8_t i = 0; i < mapCount; i++) {
+            registerDef(map, i, def);
+            if (def.address < start) continue;
+            if (def.address > start || i + count > mapCount) return -1;
+            registerDef(map, i + count - 1, def);
+            return def.address == start + count - 1 ? i : -1;
+        }
+        return -1;
+    }
+
+    // read count registers from start into response after the function
+    // code; the PDU length or an exception
+    uint8_t readRegisters(const RegisterDef *map, uint8_t mapCount, uint16_t start, uint16_t count, uint8_t *response, uint8_t size)
+    {
+        RegisterDef def;
+        // address, function, byte count, data, crc
+        if (count == 0 || 3 + count * 2 + 2 > size) return exception(response, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+        int index = find(map, mapCount, start, count);
+        if (index < 0) return exception(response, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+        response[2] = count * 2;
+        for (uint16_t i = 0; i < count; i++) {
+            registerDef(map, index + i, def);
+            uint16_t value = registerRead(def);
+            response[3 + i * 2] = value >> 8;
+            response[4 + i * 2] = value;
+        }
+        return 2 + count * 2;
+    }
+
+    // write count holding registers from start, all of them or none; 0 or
+    // an exception code
+    uint8_t writeRegisters(uint16_t start, uint16_t count, const uint8_t *values)
+    {
+        RegisterDef def;
+        int index = find(holding, holdingCount, start, count);
+        if (index < 0) return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+        writeStart = start;
+        writeCount = count;
+        writeValues = values;
+        uint8_t error = 0;
+        // check every register before storing any of them
+        for (uint16_t i = 0; i < count && !error; i++) {
+            uint16_t value = word(&values[i * 2]);
+            registerDef(holding, index + i, def);
+            if ((def.flags & writeFlags) != writeFlags) error = MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+            else if (!registerAccepts(def, value)) error = MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+        }
+        for (uint16_t i = 0; i < count && !error; i++) {
+            uint16_t value = word(&values[i * 2]);
+            registerDef(holding, index + i, def);
+            registerAccepts(def, value);
+            registerStore(def, value);
+        }
+        writeValues = 0;
+        return error;
+    }
+
+    // the shortest PDU of a supported function, 0 for any other
+    static uint8_t minLength(uint8_t function)
+    {
+        switch (function) {
+        case MODBUS_FC_READ_HOLDING_REGISTERS:
+        case MODBUS_FC_READ_INPUT_REGISTERS:
+        case MODBUS_FC_WRITE_SINGLE_REGISTER:
+            return 5;
+        case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+            return 6;
+        case MODBUS_FC_READ_WRITE_MULTIPLE_REGISTERS:
+            return 10;
+        }
+        return 0;
+    }
+
+    // handle the PDU in request (function code onwards), write the response
+    // PDU after the address byte in response and return its length
+    uint8_t process(const uint8_t *request, uint8_t length, uint8_t *response, uint8_t size)
+    {
+        uint8_t function = request[0];
+        response[1] = function;
+        uint8_t minimum = minLength(function);
+        if (!minimum) return exception(response, MODBUS_EXCEPTION_ILLEGAL_FUNCTION);
+        if (length < minimum) return exception(response, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+
+        uint16_t start = word(&request[1]);
+        uint16_t count = word(&request[3]);
+        const RegisterDef *map = function == MODBUS_FC_READ_INPUT_REGISTERS ? input : holding;
+        uint8_t mapCount = function == MODBUS_FC_READ_INPUT_REGISTERS ? inputCount : holdingCount;
+        RegisterDef def;
+        int index;
+        uint8_t error;
+
+        switch (function) {
+        case MODBUS_FC_READ_HOLDING_REGISTERS:
+        case MODBUS_FC_READ_INPUT_REGISTERS:
+            return readRegisters(map, mapCount, start, count, response, size);
+
+        case MODBUS_FC_WRITE_SINGLE_REGISTER:
+            // the value sits where the quantity is for the other functions
+            index = find(map, mapCount, start, 1);
+            if (index < 0) return exception(response, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+            registerDef(map, index, def);
+            if ((def.flags & writeFlags) != writeFlags) return exception(response, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+            if (!registerAccepts(def, count)) return exception(response, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+            registerStore(def, count);
+            for (uint8_t i = 1; i < 5; i++) response[1 + i] = request[i];
+            return 5;
+
+        case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+            if (count == 0 || request[5] != count * 2 || length < 6 + count * 2) {
+                return exception(response, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+            }
+            error = writeRegisters(start, count, &request[6]);
+            if (error) return exception(response, error);
+            for (uint8_t i = 1; i < 5; i++) response[1 + i] = request[i];
+            return 5;
+
+        case MODBUS_FC_READ_WRITE_MULTIPLE_REGISTERS: {
+            // read start and count, then write start, count, byte count and
+            // values; the write goes first, so the read sees its effect
+            uint16_t writeStart = word(&request[5]);
+            uint16_t writeCount = word(&request[7]);
+            if (writeCount == 0 || request[9] != writeCount * 2 || length < 10 + writeCount * 2) {
+                return exception(response, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+            }
+            if (count == 0 || 3 + count * 2 + 2 > size) return exception(response, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+            if (find(holding, holdingCount, start, count) < 0) return exception(response, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+            error = writeRegisters(writeStart, writeCount, &request[10]);
+            if (error) return exception(response, error);
+            return readRegisters(holding, holdingCount, start, count, response, size);
+        }
+        }
+        return exception(response, MODBUS_EXCEPTION_ILLEGAL_FUNCTION);
+    }
+
+public:
+    ModbusSlave()
+        : address(0), group(0), writeFlags(REGISTER_WRITABLE), holding(0), holdingCount(0), input(0), inputCount(0),
+          writeStart(0), writeCount(0), writeValues(0) {
+    }
+
+    void begin(uint8_t address)
+    {
+        this->address = address;
+    }
+
+    // 0 leaves the group, 1..MODBUS_MAX_GROUP joins one
+    void setGroup(uint8_t group)
+    {
+        this->group = group <= MODBUS_MAX_GROUP ? group : 0;
+    }
+
+    // maps are flash tables checked with registerMapValid()
+    void configureHoldingRegisters(const RegisterDef *map, uint8_t count)
+    {
+        holding = map;
+        holdingCount = count;
+    }
+
+    void configureInputRegisters(const RegisterDef *map, uint8_t count)
+    {
+        input = map;
+        inputCount = count;
+    }
+
+    // the value, clamped, a write in progress stores in holding register
+    // address; false if it leaves the register alone. Lets a validator check
+    // registers that are only valid together against the same frame.
+    bool pending(uint16_t address, uint16_t &value)
+    {
+        if (!writeValues || address < writeStart || address >= writeStart + writeCount) return false;
+        RegisterDef def;
+        registerDef(holding, find(holding, holdingCount, writeStart, writeCount) + address - writeStart, def);
+        value = registerClamp(def, word(&writeValues[(address - writeStart) * 2]));
+        return true;
+    }
+
+    // whether a complete RTU frame is intact and addressed to this slave,
+    // directly, by broadcast or to its group
+    bool accepts(const uint8_t *request, uint8_t length)
+    {
+        if (length < MODBUS_MIN_FRAME || modbusCrc(request, length) != 0) return false;
+        return request[0] == address || request[0] == MODBUS_BROADCAST_ADDRESS || (group && request[0] == MODBUS_GROUP_ADDRESS_BASE + group);
+    }
+
+    // handle a complete RTU frame; returns the length of the response frame
+    // written to response, 0 when nothing must be sent
+    //
+    // Broadcast and group frames are never answered and may only write
+    // registers flagged REGISTER_BROADCAST, so one frame can reconfigure a
+    // whole bus segment.
+    uint8_t handle(const uint8_t *request, uint8_t length, uint8_t *response, uint8_t size)
+    {
+        if (!accepts(request, length)) return 0;
+
+        uint8_t function = request[1];
+        if (request[0] == MODBUS_BROADCAST_ADDRESS || (group && request[0] == MODBUS_GROUP_ADDRESS_BASE + group)) {
+            if (function == MODBUS_FC_WRITE_SINGLE_REGISTER || function == MODBUS_FC_WRITE_MULTIPLE_REGISTERS) {
+                writeFlags = REGISTER_WRITABLE | REGISTER_BROADCAST;
+                process(&request[1], length - 3, response, size);
+                writeFlags = REGISTER_WRITABLE;
+            }
+            return 0;
+        }
+
+        response[0] = address;
+        uint8_t pduLength = process(&request[1], length - 3, response, size);
+        // address, PDU and CRC must fit in response
+        if (3 + pduLength > size) {
+            if (size < 5) return 0;
+            pduLength = exception(response, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+        }
+        uint16_t crc = modbusCrc(response, 1 + pduLength);
+        response[1 + pduLength] = crc;
+        response[2 + pduLength] = crc >> 8;
+        return 3 + pduLength;
+    }
+};
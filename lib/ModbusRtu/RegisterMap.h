@@ -0,0 +1,174 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+#define PROGMEM
+#define memcpy_P memcpy
+#endif
+
+// A register map is a constexpr table, sorted by address, that binds each
+// Modbus register straight to the variable holding the value. Multi-word
+// values take one entry per word. Tables live in flash; registerMapValid()
+// lets the firmware static_assert their layout.
+
+enum RegisterType : uint8_t
+{
+    REGISTER_U8,
+    REGISTER_U16,
+    REGISTER_I16,
+    REGISTER_U32_HI,
+    REGISTER_U32_LO,
+    REGISTER_FLOAT_HI,
+    REGISTER_FLOAT_LO,
+    REGISTER_BYTES,     // two bytes in memory order, the first in the high byte
+};
+
+#define REGISTER_WRITABLE 0x01
+#define REGISTER_BROADCAST 0x02 // also writable by broadcast and group frames
+
+struct RegisterDef
+{
+    uint16_t address;
+    uint8_t type;
+    uint8_t flags;
+    void *data;
+    uint16_t min;                       // writes are clamped to min..max
+    uint16_t max;
+    bool (*validate)(uint16_t value);   // optional, false rejects the write
+    void (*changed)(void);              // optional, called after a write
+};
+
+#define REGISTER_RO(address, type, data) { address, type, 0, data, 0, 0xffff, 0, 0 }
+#define REGISTER_RW(address, type, data, min, max, validate, changed) { address, type, REGISTER_WRITABLE, data, min, max, validate, changed }
+#define REGISTER_RW_BROADCAST(address, type, data, min, max, validate, changed) { address, type, REGISTER_WRITABLE | REGISTER_BROADCAST, data, min, max, validate, changed }
+#define REGISTER_U32(address, data) REGISTER_RO(address, REGISTER_U32_HI, data), REGISTER_RO((address) + 1, REGISTER_U32_LO, data)
+#define REGISTER_FLOAT(address, data) REGISTER_RO(address, REGISTER_FLOAT_HI, data), REGISTER_RO((address) + 1, REGISTER_FLOAT_LO, data)
+
+constexpr bool registerMapValid(const RegisterDef *map, uint16_t N)
+{
+    for (uint16_t i = 0; i < N; i++) {
+        const RegisterDef &def = map[i];
+        if (!def.data) return false;
+        // addresses strictly ascending: no overlaps and lookups can stop early
+        if (i > 0 && def.address <= map[i - 1].address) return false;
+        if ((def.flags & REGISTER_BROADCAST) && !(def.flags & REGISTER_WRITABLE)) return false;
+        if (def.flags & REGISTER_WRITABLE) {
+            if (def.type != REGISTER_U8 && def.type != REGISTER_U16 && def.type != REGISTER_I16) return false;
+            if (def.type == REGISTER_I16 ? (int16_t)def.min > (int16_t)def.max : def.min > def.max) return false;
+            if (def.type == REGISTER_U8 && def.max > 0xff) return false;
+        }
+        // both words of a 32-bit value, high word first
+        if ((def.type == REGISTER_U32_HI || def.type == REGISTER_FLOAT_HI)
+            && (i + 1 >= N || map[i + 1].data != def.data || map[i + 1].address != def.address + 1
+                || map[i + 1].type != def.type + 1)) return false;
+    }
+    return true;
+}
+
+template <uint16_t N>
+constexpr bool registerMapValid(const RegisterDef (&map)[N])
+{
+    return registerMapValid(map, N);
+}
+
+// A register map assembled by constexpr code, for layouts that depend on a
+// template parameter. Build it in a constexpr function with add(), addU32()
+// and addFloat(), then store the result in flash.
+template <uint16_t N>
+struct RegisterTable
+{
+    RegisterDef defs[N];
+    uint16_t size;
+
+    constexpr void add(const RegisterDef &def)
+    {
+        defs[size++] = def;
+    }
+
+    constexpr void addU32(uint16_t address, void *data)
+    {
+        add(REGISTER_RO(address, REGISTER_U32_HI, data));
+        add(REGISTER_RO((uint16_t)(address + 1), REGISTER_U32_LO, data));
+    }
+
+    constexpr void addFloat(uint16_t address, void *data)
+    {
+        add(REGISTER_RO(address, REGISTER_FLOAT_HI, data));
+        add(REGISTER_RO((uint16_t)(address + 1), REGISTER_FLOAT_LO, data));
+    }
+
+    // a byte string, e.g. an id, two bytes per register
+    constexpr void addBytes(uint16_t address, uint8_t *data, uint8_t length)
+    {
+        for (uint8_t i = 0; i < length; i += 2) {
+            add(REGISTER_RO((uint16_t)(address + i / 2), REGISTER_BYTES, data + i));
+        }
+    }
+};
+
+// every slot filled and the map valid
+template <uint16_t N>
+constexpr bool registerMapValid(const RegisterTable<N> &table)
+{
+    return table.size == N && registerMapValid(table.defs, N);
+}
+
+inline void registerDef(const RegisterDef *map, uint8_t index, RegisterDef &def)
+{
+    memcpy_P(&def, &map[index], sizeof(def));
+}
+
+inline uint16_t registerRead(const RegisterDef &def)
+{
+    uint32_t value;
+    switch (def.type) {
+    case REGISTER_U8:
+        return *(const uint8_t *)def.data;
+    case REGISTER_U16:
+    case REGISTER_I16:
+        return *(const uint16_t *)def.data;
+    case REGISTER_BYTES:
+        return ((const uint8_t *)def.data)[0] << 8 | ((const uint8_t *)def.data)[1];
+    }
+    // 32-bit integers and floats are sent as their raw bits
+    memcpy(&value, def.data, sizeof(value));
+    return def.type == REGISTER_U32_HI || def.type == REGISTER_FLOAT_HI ? value >> 16 : value;
+}
+
+// value clamped into the register's range
+inline uint16_t registerClamp(const RegisterDef &def, uint16_t value)
+{
+    if (def.type == REGISTER_I16) {
+        if ((int16_t)value < (int16_t)def.min) value = def.min;
+        if ((int16_t)value > (int16_t)def.max) value = def.max;
+    } else {
+        if (value < def.min) value = def.min;
+        if (value > def.max) value = def.max;
+    }
+    return value;
+}
+
+// clamp value into the register's range and run its validator; false when
+// the register is read-only or the value is rejected
+inline bool registerAccepts(const RegisterDef &def, uint16_t &value)
+{
+    if (!(def.flags & REGISTER_WRITABLE)) return false;
+    value = registerClamp(def, value);
+    return !def.validate || def.validate(value);
+}
+
+// store a value already checked by registerAccepts(), the changed callback
+// only runs when the value is different
+inline void registerStore(const RegisterDef &def, uint16_t value)
+{
+    if (registerRead(def) == value) return;
+    if (def.type == REGISTER_U8) {
+        *(uint8_t *)def.data = value;
+    } else {
+        *(uint16_t *)def.data = value;
+    }
+    if (def.changed) def.changed();
+}
@@ -0,0 +1,187 @@
+#include "RtuFramer.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#if !defined(USART_RX_vect) || !defined(TIMER2_COMPA_vect)
+#error "RtuFramer supports the ATmega328P USART0 and Timer2 only"
+#endif
+
+RtuFramerClass RtuFramer;
+
+// Timer2 prescalers and their CS22:0 bits
+static const uint16_t timerPrescalers[] PROGMEM = { 1, 8, 32, 64, 128, 256, 1024 };
+
+void RtuFramerClass::begin(unsigned long baud, uint8_t dePin)
+{
+    this->dePin = dePin;
+    pinMode(dePin, OUTPUT);
+    digitalWrite(dePin, LOW);
+
+    rxHead = rxTail = rxFrameStart = 0;
+    frameHead = frameTail = 0;
+    inFrame = frameError = false;
+    dropped = 0;
+    txLength = txIndex = 0;
+
+    // Modbus counts 11 bits per character; above 19200 baud the spec fixes
+    // t1.5 at 750 us and t3.5 at 1750 us
+    uint32_t charUs = 11000000UL / baud;
+    uint32_t t15Us = baud > 19200 ? 750 : charUs * 3 / 2;
+    uint32_t t35Us = baud > 19200 ? 1750 : charUs * 7 / 2;
+
+    // gaps are measured from one RX complete to the next, so they include
+    // the character itself
+    uint8_t clock = 0;
+    uint32_t ticksPerMs;
+    for (;;) {
+        ticksPerMs = F_CPU / 1000UL / pgm_read_word(&timerPrescalers[clock]);
+        if (t35Us * ticksPerMs / 1000 <= 255 || clock == sizeof(timerPrescalers) / sizeof(timerPrescalers[0]) - 1) break;
+        clock++;
+    }
+    uint32_t t35Ticks = min(t35Us * ticksPerMs / 1000, 255UL);
+    t15Ticks = min((charUs + t15Us) * ticksPerMs / 1000, t35Ticks - 1);
+    timerClock = clock + 1;
+
+    TCCR2B = 0;
+    TCCR2A = _BV(WGM21);
+    OCR2A = t35Ticks;
+    TCNT2 = 0;
+    TIFR2 = _BV(OCF2A);
+    TIMSK2 = _BV(OCIE2A);
+
+    uint16_t ubrr = (F_CPU / 4 / baud - 1) / 2;
+    UBRR0H = ubrr >> 8;
+    UBRR0L = ubrr;
+    UCSR0A = _BV(U2X0);
+    UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+    UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+}
+
+uint8_t RtuFramerClass::receive(uint8_t *frame, uint8_t size)
+{
+    if (frameTail == frameHead) return 0;
+
+    uint8_t end = frameEnd[frameTail];
+    receivedClosed = frameClosed[frameTail];
+    uint8_t tail = rxTail;
+    uint8_t length = 0;
+    while (tail != end) {
+        if (length < size) frame[length] = rxBuffer[tail];
+        length++;
+        tail = (tail + 1) & (RTU_RX_BUFFER_SIZE - 1);
+    }
+    rxTail = tail;
+    frameTail = (frameTail + 1) & (RTU_FRAME_QUEUE_SIZE - 1);
+    return length <= size ? length : 0;
+}
+
+bool RtuFramerClass::send(const uint8_t *data, uint8_t length)
+{
+    if (busy() || length == 0 || length > RTU_TX_BUFFER_SIZE) return false;
+
+    memcpy(txBuffer, data, length);
+    txIndex = 0;
+    txLength = length;
+
+    // half duplex: stop listening to our own echo until the frame is out
+    UCSR0B &= ~(_BV(RXEN0) | _BV(RXCIE0));
+    digitalWrite(dePin, HIGH);
+    UCSR0A |= _BV(TXC0);
+    UCSR0B |= _BV(UDRIE0);
+    return true;
+}
+
+uint16_t RtuFramerClass::droppedFrames()
+{
+    uint16_t count;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        count = dropped;
+    }
+    return count;
+}
+
+size_t RtuFramerClass::write(uint8_t c)
+{
+    while (!send(&c, 1)) {}
+    return 1;
+}
+
+void RtuFramerClass::onReceive()
+{
+    uint8_t status = UCSR0A;
+    uint8_t data = UDR0;
+    uint8_t gap = TCNT2;
+
+    TCNT2 = 0;
+    TIFR2 = _BV(OCF2A);
+    if (inFrame) {
+        if (gap > t15Ticks) frameError = true;
+    } else {
+        inFrame = true;
+        frameError = false;
+        TCCR2B = timerClock;
+    }
+    if (status & (_BV(FE0) | _BV(DOR0))) frameError = true;
+
+    uint8_t next = (rxHead + 1) & (RTU_RX_BUFFER_SIZE - 1);
+    if (next == rxTail) {
+        frameError = true;
+    } else {
+        rxBuffer[rxHead] = data;
+        rxHead = next;
+    }
+}
+
+void RtuFramerClass::onFrameTimeout()
+{
+    TCCR2B = 0;
+    inFrame = false;
+
+    uint8_t next = (frameHead + 1) & (RTU_FRAME_QUEUE_SIZE - 1);
+    if (!frameError && rxHead != rxFrameStart && next != frameTail) {
+        frameEnd[frameHead] = rxHead;
+        frameClosed[frameHead] = micros();
+        frameHead = next;
+        rxFrameStart = rxHead;
+    } else {
+        rxHead = rxFrameStart;
+        dropped++;
+    }
+}
+
+void RtuFramerClass::onDataRegisterEmpty()
+{
+    UDR0 = txBuffer[txIndex++];
+    if (txIndex == txLength) {
+        UCSR0B = (UCSR0B & ~_BV(UDRIE0)) | _BV(TXCIE0);
+    }
+}
+
+void RtuFramerClass::onTransmitComplete()
+{
+    UCSR0B &= ~_BV(TXCIE0);
+    digitalWrite(dePin, LOW);
+    txLength = 0;
+    UCSR0B |= _BV(RXEN0) | _BV(RXCIE0);
+}
+
+ISR(USART_RX_vect)
+{
+    RtuFramer.onReceive();
+}
+
+ISR(TIMER2_COMPA_vect)
+{
+    RtuFramer.onFrameTimeout();
+}
+
+ISR(USART_UDRE_vect)
+{
+    RtuFramer.onDataRegisterEmpty();
+}
+
+ISR(USART_TX_vect)
+{
+    RtuFramer.onTransmitComplete();
+}
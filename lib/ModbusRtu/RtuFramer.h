@@ -0,0 +1,87 @@
+#pragma once
+#include <Arduino.h>
+
+// Interrupt driven Modbus RTU transport on USART0 of the ATmega328P.
+//
+// Every received byte restarts Timer2; when the line has been silent for
+// 3.5 character times the compare match closes the frame and queues it, so
+// frame boundaries do not depend on how often loop() gets to run. A gap of
+// more than 1.5 characters inside a frame, a framing/overrun error or a
+// full buffer marks the frame bad and it is dropped. Responses are sent from
+// a buffer by the data register empty interrupt and the DE pin is released
+// by the transmit complete interrupt.
+//
+// Timer2 is taken over, so analogWrite() on pins 3 and 11 and tone() are not
+// available. HardwareSerial must not be used: it owns the same vectors.
+
+#define RTU_RX_BUFFER_SIZE 128 // power of two
+#define RTU_FRAME_QUEUE_SIZE 4 // power of two
+#define RTU_TX_BUFFER_SIZE 64
+
+class RtuFramerClass : public Print {
+    uint8_t dePin;
+    uint8_t timerClock;
+    uint8_t t15Ticks;
+
+    uint8_t rxBuffer[RTU_RX_BUFFER_SIZE];
+    volatile uint8_t rxHead;
+    volatile uint8_t rxTail;
+    volatile uint8_t rxFrameStart;
+    volatile bool inFrame;
+    volatile bool frameError;
+    volatile uint8_t frameEnd[RTU_FRAME_QUEUE_SIZE];
+    volatile uint32_t frameClosed[RTU_FRAME_QUEUE_SIZE];
+    uint32_t receivedClosed;
+    volatile uint8_t frameHead;
+    volatile uint8_t frameTail;
+    volatile uint16_t dropped;
+
+    uint8_t txBuffer[RTU_TX_BUFFER_SIZE];
+    volatile uint8_t txLength;
+    volatile uint8_t txIndex;
+
+public:
+    void begin(unsigned long baud, uint8_t dePin);
+
+    // number of complete frames waiting for receive()
+    uint8_t available()
+    {
+        return (frameHead - frameTail) & (RTU_FRAME_QUEUE_SIZE - 1);
+    }
+
+    // copy the oldest complete frame to frame, returns its length or 0 when
+    // there is none or it does not fit into size
+    uint8_t receive(uint8_t *frame, uint8_t size);
+
+    // micros() when the frame last returned by receive() was closed, 3.5
+    // characters after its last byte
+    uint32_t frameMicros()
+    {
+        return receivedClosed;
+    }
+
+    // queue a frame for transmission, fails while the previous one is still
+    // being sent
+    bool send(const uint8_t *data, uint8_t length);
+
+    bool busy()
+    {
+        return txLength != 0;
+    }
+
+    // frames discarded because of timing, line errors or a full buffer
+    uint16_t droppedFrames();
+
+    // blocking byte output for DEBUG builds, it shares the bus like the
+    // Serial prints did before
+    size_t write(uint8_t c) override;
+    using Print::write;
+
+    // called from the interrupt vectors only
+    void onReceive();
+    void onFrameTimeout();
+    void onDataRegisterEmpty();
+    void onTransmitComplete();
+};
+
+extern RtuFramerClass RtuFramer;
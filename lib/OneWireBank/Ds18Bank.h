@@ -0,0 +1,108 @@
+#pragma once
+#include "OneWireBank.h"
+#include "Ds18Search.h"
+
+// DS18x20 sensors over a OneWireBank, in the slots of a Ds18Search. Reads go
+// through the buses in lockstep, one sensor per bus at a time.
+
+#define DS18_MATCH_ROM 0x55
+#define DS18_SKIP_ROM 0xcc
+#define DS18_CONVERT 0x44
+#define DS18_READ_SCRATCHPAD 0xbe
+
+template <uint8_t Buses, uint8_t PerBus>
+class Ds18Bank {
+    static_assert(Buses <= ONE_WIRE_BANK_MAX_BUSES, "too many buses for one bank");
+
+    static constexpr uint8_t allBuses = (1 << Buses) - 1;
+
+    const uint8_t *pins;
+    const Ds18Search<Buses, PerBus> &roms;
+    OneWireBank bank;
+
+    // the nth sensor of the given buses; the buses whose scratchpad passed
+    uint8_t readScratchpads(uint8_t n, uint8_t buses, float *temperatures)
+    {
+        uint8_t rom[8][Buses];
+        for (uint8_t bus = 0; bus < Buses; bus++) {
+            const uint8_t *address = roms.address(bus * PerBus + n);
+            for (uint8_t i = 0; i < 8; i++) {
+                rom[i][bus] = address[i];
+            }
+        }
+        buses &= bank.reset(buses);
+        if (!buses) return 0;
+
+        uint8_t scratchpad[DS18_SCRATCHPAD_SIZE][Buses];
+        bank.write(buses, DS18_MATCH_ROM);
+        for (uint8_t i = 0; i < 8; i++) {
+            bank.write(buses, rom[i]);
+        }
+        bank.write(buses, DS18_READ_SCRATCHPAD);
+        for (uint8_t i = 0; i < DS18_SCRATCHPAD_SIZE; i++) {
+            bank.read(buses, scratchpad[i]);
+        }
+
+        uint8_t passed = 0;
+        for (uint8_t bus = 0; bus < Buses; bus++) {
+            if (!(buses & (1 << bus))) continue;
+            uint8_t slot = bus * PerBus + n;
+            uint8_t bytes[DS18_SCRATCHPAD_SIZE];
+            for (uint8_t i = 0; i < DS18_SCRATCHPAD_SIZE; i++) {
+                bytes[i] = scratchpad[i][bus];
+            }
+            if (!ds18ScratchpadValid(bytes)) continue;
+            temperatures[slot] = ds18Celsius(bytes, rom[0][bus]);
+            passed |= 1 << bus;
+        }
+        return passed;
+    }
+
+public:
+    Ds18Bank(const uint8_t *pins, const Ds18Search<Buses, PerBus> &roms) : pins(pins), roms(roms) {
+    }
+
+    void begin()
+    {
+        bank.begin(pins, Buses);
+    }
+
+    // start a conversion on every sensor of every bus
+    void requestTemperatures()
+    {
+        uint8_t buses = bank.reset(allBuses);
+        bank.write(buses, DS18_SKIP_ROM);
+        bank.write(buses, DS18_CONVERT);
+    }
+
+    // read every present sensor into temperatures[slot], DS18_DISCONNECTED
+    // where it fails. Failed reads are retried while retries last, each retry
+    // covers the failed sensors of every bus at once; errors[slot] counts
+    // the failed reads. The slots read, as a bitmask.
+    uint8_t read(float *temperatures, uint16_t *errors, uint8_t retries)
+    {
+        uint8_t valid = 0;
+        for (uint8_t n = 0; n < PerBus; n++) {
+            uint8_t buses = 0;
+            for (uint8_t bus = 0; bus < Buses; bus++) {
+                uint8_t slot = bus * PerBus + n;
+                temperatures[slot] = DS18_DISCONNECTED;
+                if (roms.present(slot)) buses |= 1 << bus;
+            }
+            for (;;) {
+                buses &= ~readScratchpads(n, buses, temperatures);
+                for (uint8_t bus = 0; bus < Buses; bus++) {
+                    uint8_t slot = bus * PerBus + n;
+                    if ((buses & (1 << bus)) && errors[slot] < UINT16_MAX) errors[slot]++;
+                }
+                if (!buses || !retries) break;
+                retries--;
+            }
+            for (uint8_t bus = 0; bus < Buses; bus++) {
+                uint8_t slot = bus * PerBus + n;
+                if (roms.present(slot) && !(buses & (1 << bus))) valid |= 1 << slot;
+            }
+        }
+        return valid;
+    }
+};
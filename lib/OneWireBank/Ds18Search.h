@@ -0,0 +1,152 @@
+#pragma once
+#include <OneWire.h>
+
+// DS18x20 ROM table with fixed slots: slot bus * PerBus + n holds a sensor of
+// that bus. The search runs in steps of one sensor, so it can go on in the
+// background while sensors come and go. A sensor keeps its slot while it is
+// found, a new one takes the first free slot of its bus, and a slot is freed
+// once its sensor is missing from two sweeps in a row.
+
+#define DS18_SCRATCHPAD_SIZE 9
+#define DS18_DISCONNECTED -127
+
+inline bool ds18Family(uint8_t family)
+{
+    return family == 0x10 || family == 0x22 || family == 0x28 || family == 0x3b || family == 0x42;
+}
+
+inline bool ds18RomValid(const uint8_t *rom)
+{
+    return ds18Family(rom[0]) && OneWire::crc8(rom, 7) == rom[7];
+}
+
+// an all-zero scratchpad passes the crc, a missing sensor reads 0xff
+inline bool ds18ScratchpadValid(const uint8_t *scratchpad)
+{
+    return OneWire::crc8(scratchpad, 8) == scratchpad[8] && scratchpad[4] != 0;
+}
+
+inline float ds18Celsius(const uint8_t *scratchpad, uint8_t family)
+{
+    int16_t raw = (scratchpad[1] << 8) | scratchpad[0];
+    if (family == 0x10) {
+        // DS18S20: 1/2 C steps, extended with COUNT_REMAIN
+        raw = ((raw << 3) & 0xfff0) + 12 - scratchpad[6];
+    } else {
+        // the low bits are undefined below 12-bit resolution
+        uint8_t resolution = ((scratchpad[4] >> 5) & 0x03) + 9;
+        raw &= ~((1 << (12 - resolution)) - 1);
+    }
+    return raw / 16.0;
+}
+
+template <uint8_t Buses, uint8_t PerBus>
+class Ds18Search {
+    static constexpr uint8_t slots = Buses * PerBus;
+    static_assert(slots <= 8, "slots are tracked as a bitmask");
+
+    const uint8_t *pins;
+    OneWire wire;
+    uint8_t bus = 0;            // searched by the next step
+    bool searching = false;     // a search of that bus is in progress
+    uint8_t seen = 0;           // slots found during this sweep
+    uint8_t missed = 0;         // slots missing from the last sweep
+
+    void found(const uint8_t *rom)
+    {
+        uint8_t free = slots;
+        for (uint8_t slot = bus * PerBus; slot < (bus + 1) * PerBus; slot++) {
+            if (!present(slot)) {
+                if (free == slots) free = slot;
+            } else if (memcmp(roms[slot], rom, 8) == 0) {
+                seen |= 1 << slot;
+                return;
+            }
+        }
+        // no room on this bus: the sensor is left out
+        if (free == slots) return;
+        memcpy(roms[free], rom, 8);
+        seen |= 1 << free;
+        changed |= 1 << free;
+    }
+
+    // the bus search ended: free the slots missing twice in a row
+    void busDone(void)
+    {
+        for (uint8_t slot = bus * PerBus; slot < (bus + 1) * PerBus; slot++) {
+            uint8_t bit = 1 << slot;
+            if (!present(slot) || (seen & bit)) {
+                missed &= ~bit;
+            } else if (missed & bit) {
+                memset(roms[slot], 0, 8);
+                missed &= ~bit;
+                changed |= bit;
+            } else {
+                missed |= bit;
+            }
+        }
+    }
+
+public:
+    uint8_t roms[slots][8];     // family code 0 marks an empty slot
+    uint8_t changed = 0;        // slots added or freed, for the caller to clear
+
+    Ds18Search(const uint8_t *pins) : pins(pins) {
+    }
+
+    // keep the valid ROMs already in roms, e.g. restored from EEPROM, and
+    // empty the other slots
+    void begin()
+    {
+        for (uint8_t slot = 0; slot < slots; slot++) {
+            if (!ds18RomValid(roms[slot])) memset(roms[slot], 0, 8);
+        }
+    }
+
+    bool present(uint8_t slot) const
+    {
+        return roms[slot][0] != 0;
+    }
+
+    const uint8_t *address(uint8_t slot) const
+    {
+        return roms[slot];
+    }
+
+    uint8_t count() const
+    {
+        uint8_t n = 0;
+        for (uint8_t slot = 0; slot < slots; slot++) {
+            if (present(slot)) n++;
+        }
+        return n;
+    }
+
+    // one search step, at most one sensor found (about 14 ms); true when a
+    // sweep over every bus has just ended
+    bool step()
+    {
+        if (!searching) {
+            wire.begin(pins[bus]);
+            wire.reset_search();
+            searching = true;
+        }
+        uint8_t rom[8];
+        if (wire.search(rom)) {
+            if (ds18RomValid(rom)) found(rom);
+            return false;
+        }
+        busDone();
+        searching = false;
+        if (++bus < Buses) return false;
+        bus = 0;
+        seen = 0;
+        return true;
+    }
+
+    // a whole sweep at once, at boot
+    void sweep()
+    {
+        while (!step());
+    }
+};
@@ -0,0 +1,133 @@
+#include "OneWireBank.h"
+
+// slot timing as in the OneWire library, in us
+#define SLOT_WRITE_LOW_1 10
+#define SLOT_WRITE_LOW_0 65
+#define SLOT_WRITE_RECOVERY 5
+#define SLOT_READ_LOW 3
+#define SLOT_READ_SAMPLE 10
+#define SLOT_READ_RECOVERY 53
+#define RESET_LOW 480
+#define RESET_SAMPLE 70
+#define RESET_RECOVERY 410
+
+void OneWireBank::begin(const uint8_t *pins, uint8_t count)
+{
+    uint8_t port = digitalPinToPort(pins[0]);
+    mode = portModeRegister(port);
+    out = portOutputRegister(port);
+    in = portInputRegister(port);
+    this->count = min(count, ONE_WIRE_BANK_MAX_BUSES);
+    for (uint8_t bus = 0; bus < this->count; bus++) {
+        bits[bus] = digitalPinToBitMask(pins[bus]);
+    }
+    release();
+}
+
+// inputs with the output bits low, the external pull-ups hold the buses
+// high and a slot only has to set the mode bit to pull one low. OneWire
+// (the ROM search) leaves its pin driving high, so every reset starts here.
+void OneWireBank::release(void)
+{
+    uint8_t all = portBits(0xff);
+    noInterrupts();
+    *mode &= ~all;
+    *out &= ~all;
+    interrupts();
+}
+
+uint8_t OneWireBank::portBits(uint8_t buses) const
+{
+    uint8_t mask = 0;
+    for (uint8_t bus = 0; bus < count; bus++) {
+        if (buses & (1 << bus)) mask |= bits[bus];
+    }
+    return mask;
+}
+
+uint8_t OneWireBank::reset(uint8_t buses)
+{
+    uint8_t mask = portBits(buses);
+    release();
+
+    // a bus that stays low, shorted or without pull-up, is left out
+    uint8_t retries = 125;
+    while ((*in & mask) != mask && --retries) delayMicroseconds(2);
+    mask &= *in;
+
+    noInterrupts();
+    *mode |= mask;
+    interrupts();
+    delayMicroseconds(RESET_LOW);
+    noInterrupts();
+    *mode &= ~mask;
+    delayMicroseconds(RESET_SAMPLE);
+    uint8_t low = ~*in & mask;
+    interrupts();
+    delayMicroseconds(RESET_RECOVERY);
+
+    uint8_t present = 0;
+    for (uint8_t bus = 0; bus < count; bus++) {
+        if (low & bits[bus]) present |= 1 << bus;
+    }
+    return present;
+}
+
+void OneWireBank::writeSlot(uint8_t portMask, uint8_t ones)
+{
+    noInterrupts();
+    *mode |= portMask;
+    delayMicroseconds(SLOT_WRITE_LOW_1);
+    *mode &= ~ones;
+    delayMicroseconds(SLOT_WRITE_LOW_0 - SLOT_WRITE_LOW_1);
+    *mode &= ~portMask;
+    interrupts();
+    delayMicroseconds(SLOT_WRITE_RECOVERY);
+}
+
+uint8_t OneWireBank::readSlot(uint8_t portMask)
+{
+    noInterrupts();
+    *mode |= portMask;
+    delayMicroseconds(SLOT_READ_LOW);
+    *mode &= ~portMask;
+    delayMicroseconds(SLOT_READ_SAMPLE);
+    uint8_t sample = *in;
+    interrupts();
+    delayMicroseconds(SLOT_READ_RECOVERY);
+    return sample;
+}
+
+void OneWireBank::write(uint8_t buses, uint8_t value)
+{
+    uint8_t mask = portBits(buses);
+    for (uint8_t bit = 0x01; bit; bit <<= 1) {
+        writeSlot(mask, value & bit ? mask : 0);
+    }
+}
+
+void OneWireBank::write(uint8_t buses, const uint8_t *bytes)
+{
+    uint8_t mask = portBits(buses);
+    for (uint8_t bit = 0x01; bit; bit <<= 1) {
+        uint8_t ones = 0;
+        for (uint8_t bus = 0; bus < count; bus++) {
+            if (bytes[bus] & bit) ones |= bits[bus];
+        }
+        writeSlot(mask, ones & mask);
+    }
+}
+
+void OneWireBank::read(uint8_t buses, uint8_t *bytes)
+{
+    uint8_t mask = portBits(buses);
+    for (uint8_t bus = 0; bus < count; bus++) {
+        bytes[bus] = 0;
+    }
+    for (uint8_t bit = 0x01; bit; bit <<= 1) {
+        uint8_t sample = readSlot(mask);
+        for (uint8_t bus = 0; bus < count; bus++) {
+            if (sample & bits[bus]) bytes[bus] |= bit;
+        }
+    }
+}
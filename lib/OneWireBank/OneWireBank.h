@@ -0,0 +1,46 @@
+#pragma once
+#include <Arduino.h>
+
+// Up to ONE_WIRE_BANK_MAX_BUSES OneWire buses on one port, driven in
+// lockstep: every bit slot is a single port-wide write and read, so a byte
+// goes out on, or comes back from, all buses in the time of one. Each bus
+// can still send its own bits. Operations take a bitmask of the buses they
+// act on (bit n is bus n); a bus stuck low drops out of reset() and does not
+// disturb the others.
+
+#define ONE_WIRE_BANK_MAX_BUSES 4
+
+// port of an ATmega328P pin: 0 PORTD, 1 PORTB, 2 PORTC
+constexpr uint8_t oneWireBankPort(uint8_t pin)
+{
+    return pin < 8 ? 0 : pin < 14 ? 1 : 2;
+}
+
+class OneWireBank {
+    volatile uint8_t *mode;
+    volatile uint8_t *out;
+    volatile uint8_t *in;
+    uint8_t bits[ONE_WIRE_BANK_MAX_BUSES]; // port bit of each bus
+    uint8_t count;
+
+    uint8_t portBits(uint8_t buses) const;
+    void release(void);
+    uint8_t readSlot(uint8_t portMask);
+    void writeSlot(uint8_t portMask, uint8_t ones);
+
+public:
+    // the pins must share a port, see oneWireBankPort()
+    void begin(const uint8_t *pins, uint8_t count);
+
+    // reset pulse; the buses that answered with a presence pulse
+    uint8_t reset(uint8_t buses);
+
+    // one byte to every bus
+    void write(uint8_t buses, uint8_t value);
+
+    // bytes[n] to bus n
+    void write(uint8_t buses, const uint8_t *bytes);
+
+    // bytes[n] from bus n
+    void read(uint8_t buses, uint8_t *bytes);
+};
@@ -0,0 +1,46 @@
+#include "ResetRecord.h"
+#include <avr/io.h>
+#include <avr/wdt.h>
+
+ResetRecord resetRecord __attribute__((section(".noinit")));
+// .bss is only cleared after .init3
+static uint8_t resetCause __attribute__((section(".noinit")));
+
+// runs from .init3, before constructors and main(). The watchdog stays
+// enabled after a watchdog reset, with its shortest timeout, so it is turned
+// off here before it can fire again
+__attribute__((naked, used, section(".init3"))) static void resetRecordCapture(void)
+{
+    uint8_t cause = MCUSR;
+    // optiboot clears MCUSR and hands its value over in r2; the firmware
+    // never jumps to address 0, which would leave r2 undefined
+    if (!cause) __asm__ volatile("mov %0, r2" : "=r" (cause));
+    resetCause = cause;
+    MCUSR = 0;
+    wdt_disable();
+}
+
+void resetRecordBegin(ResetReport &report)
+{
+    // after power-on or a brown-out the RAM holds nothing of the last run
+    bool valid = resetRecord.magic == RESET_RECORD_MAGIC && !(resetCause & (_BV(PORF) | _BV(BORF)));
+
+    report.cause = resetCause;
+    report.task = valid ? resetRecord.task : RESET_RECORD_IDLE;
+    report.function = valid ? resetRecord.function : 0;
+    report.loops = valid ? resetRecord.loops : 0;
+    report.resets = valid ? resetRecord.resets + 1 : 0;
+
+    resetRecord.magic = RESET_RECORD_MAGIC;
+    resetRecord.task = RESET_RECORD_IDLE;
+    resetRecord.function = 0;
+    resetRecord.loops = 0;
+    resetRecord.resets = report.resets;
+}
+
+void resetRecordRestart(void)
+{
+    resetRecord.task = RESET_RECORD_RESTART;
+    wdt_enable(WDTO_15MS);
+    for (;;) {}
+}
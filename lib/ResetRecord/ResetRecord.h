@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+
+// What the firmware was doing when it last reset. The live record sits in
+// .noinit, which the C runtime leaves alone, so after a watchdog or external
+// reset it still holds the state from just before; only power loss clears
+// it. resetRecordBegin() publishes that state and starts a new record.
+
+#define RESET_RECORD_MAGIC 0x5a3c
+#define RESET_RECORD_IDLE 0xff // no task running
+#define RESET_RECORD_RESTART 0xfe // restarted by resetRecordRestart()
+
+struct ResetRecord
+{
+    uint16_t magic;
+    uint8_t task;           // scheduler task being run
+    uint8_t function;       // last Modbus function code received
+    uint32_t loops;         // loop() iterations since boot
+    uint16_t resets;        // resets since power-on
+};
+
+// the previous boot, as published by resetRecordBegin()
+struct ResetReport
+{
+    uint8_t cause;          // MCUSR: PORF, EXTRF, BORF, WDRF bits
+    uint8_t task;
+    uint8_t function;
+    uint32_t loops;
+    uint16_t resets;
+};
+
+extern ResetRecord resetRecord;
+
+// call once from setup(), fills report and clears the live record
+void resetRecordBegin(ResetReport &report);
+
+// restart on purpose through the watchdog, so the next boot reads a watchdog
+// reset in task RESET_RECORD_RESTART
+void resetRecordRestart(void);
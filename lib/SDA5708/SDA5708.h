@@ -1,11 +1,16 @@
-#include <font.h>
 #include <avr/pgmspace.h>
+#include <font.h>
 class SDA5708 {
     uint8_t pinLoad;
     uint8_t pinData;
     uint8_t pinClock;
     uint8_t pinReset;
 
+    // framebuffer: glyph index requested per digit and a bit per digit that
+    // differs from what the display currently shows
+    uint8_t frame[8];
+    uint8_t dirty;
+
 public:
     SDA5708(uint8_t pinLoad, uint8_t pinData, uint8_t pinClock, uint8_t pinReset)
         : pinLoad(pinLoad), pinData(pinData), pinClock(pinClock), pinReset(pinReset) {
@@ -13,6 +18,8 @@ public:
         pinMode(pinData, OUTPUT);
         pinMode(pinClock, OUTPUT);
         pinMode(pinReset, OUTPUT);
+        memset(frame, 0, sizeof(frame));
+        dirty = 0;
     }
 
     void begin(void)
@@ -20,6 +27,9 @@ public:
         digitalWrite(pinLoad, HIGH);
         digitalWrite(pinReset, LOW);
         digitalWrite(pinReset, HIGH);
+        // reset blanks the display, so the framebuffer is in sync again
+        memset(frame, 0, sizeof(frame));
+        dirty = 0;
     }
 
     void brightness(uint8_t val)
@@ -50,43 +60,96 @@ public:
 
     void digit(uint8_t sign, uint8_t digit)
     {
-        uint8_t i;
-        if ((sign < 0x20) || (sign > 0x7f)) sign = 0x20;
         if (digit > 7) digit = 0;
+        glyph(glyphIndex(sign), digit);
+    }
+
+    // send a glyph that is already known to be in range, rows are unpacked
+    // 5 bits at a time from the packed font
+    void glyph(uint8_t index, uint8_t digit)
+    {
+        const unsigned char *p = &font[index * SDA5708_GLYPH_BYTES];
+        uint16_t bits = 0;
+        uint8_t count = 0;
+        uint8_t i;
         setCyrsor(digit);
         for (i = 0; i < 7; i++) {
-            sendByte(pgm_read_byte(&font[(sign - 0x20) * 7 + i]) / 8);
+            if (count < 5) {
+                bits |= (uint16_t)pgm_read_byte(p++) << count;
+                count += 8;
+            }
+            sendByte(bits & 0x1f);
+            bits >>= 5;
+            count -= 5;
         }
     }
 
+    static uint8_t glyphIndex(uint8_t sign)
+    {
+        if ((sign < SDA5708_FIRST_CHAR) || (sign >= SDA5708_FIRST_CHAR + SDA5708_GLYPH_COUNT)) sign = ' ';
+        return sign - SDA5708_FIRST_CHAR;
+    }
+
     void setCyrsor(uint8_t cursor)
     {
         if (cursor > 7) cursor = 0;
         sendByte(0b10100000 | cursor);
     }
 
-    void print(char *text)
+    // put a character into the framebuffer, it is sent by the next flush()
+    void setChar(char sign, uint8_t cursor)
     {
-        uint8_t cursor=0;
-        char *p=text;
-        while (*p) {
-            digit(*p, cursor);
-            cursor++;
-            p++;
+        if (cursor > 7) return;
+        uint8_t index = glyphIndex(sign);
+        if (frame[cursor] != index) {
+            frame[cursor] = index;
+            dirty |= 1 << cursor;
         }
     }
 
-    void printAt(char *text, uint8_t cursor)
+    void print(const char *text)
+    {
+        printAt(text, 0);
+    }
+
+    void printAt(const char *text, uint8_t cursor)
     {
         if (cursor > 7) cursor = 0;
-        char *p=text;
-        while (*p) {
-            digit(*p, cursor);
+        const char *p=text;
+        while (*p && cursor <= 7) {
+            setChar(*p, cursor);
             cursor++;
             p++;
         }
     }
 
+    // send only the digits whose glyph changed since the last flush
+    void flush()
+    {
+        for (uint8_t i = 0; dirty; i++) {
+            if (dirty & (1 << i)) {
+                glyph(frame[i], i);
+                dirty &= ~(1 << i);
+            }
+        }
+    }
+
+    // like flush(), but stops once budgetUs has been spent so a caller can
+    // spread a redraw over several passes; at least one digit is sent per
+    // call, returns true when the display is in sync with the framebuffer
+    bool flush(unsigned long budgetUs)
+    {
+        unsigned long start = micros();
+        for (uint8_t i = 0; dirty; i++) {
+            if (dirty & (1 << i)) {
+                glyph(frame[i], i);
+                dirty &= ~(1 << i);
+                if (micros() - start >= budgetUs) break;
+            }
+        }
+        return dirty == 0;
+    }
+
     void clear()
     {
         begin();
@@ -3,778 +3,900 @@
 // data2: http://www.bralug.de/wiki/Display_SDA5708
 // adapted sketch by niq_ro: http://arduinotehniq.blogspot.com/
 
-const unsigned char font[890] PROGMEM ={
+#include <stdint.h>
 
+// Glyphs are 5 pixels wide and 7 rows high. The source rows below keep the
+// pixels left aligned in bits 7..3; SDA5708_GLYPH() shifts them into place and
+// packs the 7 x 5 bits of a glyph into 5 bytes at compile time, row 0 in the
+// least significant bits.
+#define SDA5708_FIRST_CHAR 0x20
+#define SDA5708_GLYPH_COUNT 96
+#define SDA5708_GLYPH_BYTES 5
+
+constexpr uint64_t sda5708PackGlyph(uint8_t r0, uint8_t r1, uint8_t r2, uint8_t r3, uint8_t r4, uint8_t r5, uint8_t r6)
+{
+    return (uint64_t)(r0 >> 3)
+        | ((uint64_t)(r1 >> 3) << 5)
+        | ((uint64_t)(r2 >> 3) << 10)
+        | ((uint64_t)(r3 >> 3) << 15)
+        | ((uint64_t)(r4 >> 3) << 20)
+        | ((uint64_t)(r5 >> 3) << 25)
+        | ((uint64_t)(r6 >> 3) << 30);
+}
+
+#define SDA5708_GLYPH(r0, r1, r2, r3, r4, r5, r6) \
+    (uint8_t)(sda5708PackGlyph(r0, r1, r2, r3, r4, r5, r6)), \
+    (uint8_t)(sda5708PackGlyph(r0, r1, r2, r3, r4, r5, r6) >> 8), \
+    (uint8_t)(sda5708PackGlyph(r0, r1, r2, r3, r4, r5, r6) >> 16), \
+    (uint8_t)(sda5708PackGlyph(r0, r1, r2, r3, r4, r5, r6) >> 24), \
+    (uint8_t)(sda5708PackGlyph(r0, r1, r2, r3, r4, r5, r6) >> 32)
+
+const unsigned char font[SDA5708_GLYPH_COUNT * SDA5708_GLYPH_BYTES] PROGMEM ={
+
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b00000000,
    0b00000000,
    0b00000000,
    0b00000000,
-   0b00000000,    //letter Space
-
+   0b00000000),    //letter Space
 
+   SDA5708_GLYPH(
    0b00100000,
    0b00100000,
    0b00100000,
    0b00100000,
    0b00100000,
    0b00000000,
-   0b00100000,    //letter !
+   0b00100000),    //letter !
 
+   SDA5708_GLYPH(
    0b01010000,
    0b01010000,
    0b00000000,
    0b00000000,
    0b00000000,
    0b00000000,
-   0b00000000,    //letter "
+   0b00000000),    //letter "
 
+   SDA5708_GLYPH(
    0b01010000,
    0b01010000,
    0b11111000,
    0b01010000,
    0b11111000,
    0b01010000,
-   0b01010000,    //letter #
+   0b01010000),    //letter #
 
+   SDA5708_GLYPH(
    0b00100000,
    0b01111000,
    0b10100000,
    0b01110000,
    0b00101000,
    0b00110000,
-   0b00100000,    //letter $
+   0b00100000),    //letter $
 
+   SDA5708_GLYPH(
    0b11000000,
    0b11001000,
    0b00010000,
    0b00100000,
    0b01000000,
    0b10011000,
-   0b00011000,    //letter %
-
+   0b00011000),    //letter %
 
+   SDA5708_GLYPH(
    0b01000000,
    0b10100000,
    0b01000000,
    0b10100000,
    0b10010000,
    0b10001000,
-   0b01110000,    //letter &
+   0b01110000),    //letter &
 
+   SDA5708_GLYPH(
    0b00010000,
    0b00010000,
    0b00100000,
    0b00000000,
    0b00000000,
    0b00000000,
-   0b00000000,    //letter '
+   0b00000000),    //letter '
 
+   SDA5708_GLYPH(
    0b00100000,
    0b01000000,
    0b01000000,
    0b01000000,
    0b01000000,
    0b01000000,
-   0b00100000,    //letter (
+   0b00100000),    //letter (
 
+   SDA5708_GLYPH(
    0b00010000,
    0b00001000,
    0b00001000,
    0b00001000,
    0b00001000,
    0b00001000,
-   0b00010000,    //letter )
+   0b00010000),    //letter )
 
+   SDA5708_GLYPH(
    0b00000000,
    0b10001000,
    0b01010000,
    0b11111000,
    0b01010000,
    0b10001000,
-   0b00000000,    //letter *
+   0b00000000),    //letter *
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00100000,
    0b00100000,
    0b11111000,
    0b00100000,
    0b00100000,
-   0b00000000,    //letter +
+   0b00000000),    //letter +
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b00000000,
    0b00000000,
    0b01000000,
    0b01000000,
-   0b10000000,    //letter ,
+   0b10000000),    //letter ,
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b00000000,
    0b11111000,
    0b00000000,
    0b00000000,
-   0b00000000,    //letter -
+   0b00000000),    //letter -
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b00000000,
    0b00000000,
    0b00000000,
    0b11000000,
-   0b11000000,   //letter .
+   0b11000000),    //letter .
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00001000,
    0b00010000,
    0b00100000,
    0b01000000,
    0b10000000,
-   0b00000000,   //letter /
+   0b00000000),    //letter /
 
+   SDA5708_GLYPH(
    0b01110000,
    0b10001000,
    0b10011000,
    0b10101000,
    0b11001000,
    0b10001000,
-   0b01110000,   //letter 0
+   0b01110000),    //letter 0
 
+   SDA5708_GLYPH(
    0b00100000,
    0b01100000,
    0b00100000,
    0b00100000,
    0b00100000,
    0b00100000,
-   0b01110000,   //letter 1
+   0b01110000),    //letter 1
 
+   SDA5708_GLYPH(
    0b01110000,
    0b00001000,
    0b00001000,
    0b01110000,
    0b10000000,
    0b10000000,
-   0b11111000,   //letter 2
+   0b11111000),    //letter 2
 
+   SDA5708_GLYPH(
    0b11110000,
    0b00001000,
    0b00001000,
    0b01110000,
    0b00001000,
    0b00001000,
-   0b11110000,   //letter 3
+   0b11110000),    //letter 3
 
+   SDA5708_GLYPH(
    0b00001000,
    0b00011000,
    0b00101000,
    0b01001000,
    0b11111000,
    0b00001000,
-   0b00001000,   //letter 4
+   0b00001000),    //letter 4
 
+   SDA5708_GLYPH(
    0b11111000,
    0b10000000,
    0b10000000,
    0b11110000,
    0b00001000,
    0b10001000,
-   0b01110000,   //letter 5
+   0b01110000),    //letter 5
 
+   SDA5708_GLYPH(
    0b01110000,
    0b10000000,
    0b10000000,
    0b11110000,
    0b10001000,
    0b10001000,
-   0b01110000,   //letter 6
+   0b01110000),    //letter 6
 
+   SDA5708_GLYPH(
    0b11111000,
    0b00001000,
    0b00001000,
    0b00010000,
    0b00100000,
    0b01000000,
-   0b10000000,   //letter 7
+   0b10000000),    //letter 7
 
+   SDA5708_GLYPH(
    0b01110000,
    0b10001000,
    0b10001000,
    0b01110000,
    0b10001000,
    0b10001000,
-   0b01110000,   //letter 8
+   0b01110000),    //letter 8
 
+   SDA5708_GLYPH(
    0b01110000,
    0b10001000,
    0b10001000,
    0b01111000,
    0b00010000,
    0b00100000,
-   0b01000000,   //letter 9
+   0b01000000),    //letter 9
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b01100000,
    0b01100000,
    0b00000000,
    0b01100000,
-   0b01100000,    //letter :
+   0b01100000),    //letter :
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b01100000,
    0b01100000,
    0b00000000,
    0b00100000,
-   0b01000000,    //letter ;
+   0b01000000),    //letter ;
 
+   SDA5708_GLYPH(
    0b00010000,
    0b00100000,
    0b01000000,
    0b10000000,
    0b01000000,
    0b00100000,
-   0b00010000,    //letter <
+   0b00010000),    //letter <
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b11111000,
    0b00000000,
    0b11111000,
    0b00000000,
-   0b00000000,    //letter =
+   0b00000000),    //letter =
 
+   SDA5708_GLYPH(
    0b01000000,
    0b00100000,
    0b00010000,
    0b00001000,
    0b00010000,
    0b00100000,
-   0b01000000,    //letter >
+   0b01000000),    //letter >
 
+   SDA5708_GLYPH(
    0b01110000,
    0b10001000,
    0b00001000,
    0b00110000,
    0b01000000,
    0b00000000,
-   0b01000000,    //letter ?
+   0b01000000),    //letter ?
 
+   SDA5708_GLYPH(
    0b01110000,
    0b10001000,
    0b10111000,
    0b10101000,
    0b10111000,
    0b10000000,
-   0b01111000,    //letter @
+   0b01111000),    //letter @
 
 //-----------------------------------Capital Letters
+   SDA5708_GLYPH(
    0b00100000,
    0b01010000,
    0b10001000,
    0b11111000,
    0b10001000,
    0b10001000,
-   0b10001000,    //letter A
+   0b10001000),    //letter A
 
+   SDA5708_GLYPH(
    0b11110000,
    0b10001000,
    0b10001000,
    0b11110000,
    0b10001000,
    0b10001000,
-   0b11110000,    //letter B
+   0b11110000),    //letter B
 
+   SDA5708_GLYPH(
    0b01110000,
    0b10001000,
    0b10000000,
    0b10000000,
    0b10000000,
    0b10001000,
-   0b01110000,    //letter C
+   0b01110000),    //letter C
 
+   SDA5708_GLYPH(
    0b11110000,
    0b10001000,
    0b10001000,
    0b10001000,
    0b10001000,
    0b10001000,
-   0b11110000,    //letter D
+   0b11110000),    //letter D
 
+   SDA5708_GLYPH(
    0b11111000,
    0b10000000,
    0b10000000,
    0b11110000,
    0b10000000,
    0b10000000,
-   0b11111000,    //letter E
+   0b11111000),    //letter E
 
+   SDA5708_GLYPH(
    0b11111000,
    0b10000000,
    0b10000000,
    0b11110000,
    0b10000000,
    0b10000000,
-   0b10000000,    //letter F
+   0b10000000),    //letter F
 
+   SDA5708_GLYPH(
    0b01110000,
    0b10001000,
    0b10000000,
    0b10000000,
    0b10011000,
    0b10001000,
-   0b01111000,    //letter G
+   0b01111000),    //letter G
 
+   SDA5708_GLYPH(
    0b10001000,
    0b10001000,
    0b10001000,
    0b11111000,
    0b10001000,
    0b10001000,
-   0b10001000,    //letter H
+   0b10001000),    //letter H
 
+   SDA5708_GLYPH(
    0b01110000,
    0b00100000,
    0b00100000,
    0b00100000,
    0b00100000,
    0b00100000,
-   0b01110000,    //letter I
+   0b01110000),    //letter I
 
+   SDA5708_GLYPH(
    0b11111000,
    0b00010000,
    0b00010000,
    0b00010000,
    0b10010000,
    0b10010000,
-   0b01100000,    //letter J
+   0b01100000),    //letter J
 
+   SDA5708_GLYPH(
    0b10001000,
    0b10010000,
    0b10100000,
    0b11000000,
    0b10100000,
    0b10010000,
-   0b10001000,    //letter K
+   0b10001000),    //letter K
 
+   SDA5708_GLYPH(
    0b10000000,
    0b10000000,
    0b10000000,
    0b10000000,
    0b10000000,
    0b10000000,
-   0b11111000,    //letter L
+   0b11111000),    //letter L
 
+   SDA5708_GLYPH(
    0b10001000,
    0b11011000,
    0b10101000,
    0b10001000,
    0b10001000,
    0b10001000,
-   0b10001000,    //letter M
+   0b10001000),    //letter M
 
+   SDA5708_GLYPH(
    0b10001000,
    0b11001000,
    0b10101000,
    0b10011000,
    0b10001000,
    0b10001000,
-   0b10001000,    //letter N
+   0b10001000),    //letter N
 
+   SDA5708_GLYPH(
    0b01110000,
    0b10001000,
    0b10001000,
    0b10001000,
    0b10001000,
    0b10001000,
-   0b01110000,    //letter O
+   0b01110000),    //letter O
 
+   SDA5708_GLYPH(
    0b11110000,
    0b10001000,
    0b10001000,
    0b11110000,
    0b10000000,
    0b10000000,
-   0b10000000,    //letter P
+   0b10000000),    //letter P
 
+   SDA5708_GLYPH(
    0b01110000,
    0b10001000,
    0b10001000,
    0b10001000,
    0b10101000,
    0b10011000,
-   0b01111000,    //letter Q
+   0b01111000),    //letter Q
 
+   SDA5708_GLYPH(
    0b11110000,
    0b10001000,
    0b10001000,
    0b11110000,
    0b10100000,
    0b10010000,
-   0b10001000,    //letter R
+   0b10001000),    //letter R
 
+   SDA5708_GLYPH(
    0b01111000,
    0b10000000,
    0b10000000,
    0b01110000,
    0b00001000,
    0b00001000,
-   0b11110000,    //letter S
+   0b11110000),    //letter S
 
+   SDA5708_GLYPH(
    0b11111000,
    0b00100000,
    0b00100000,
    0b00100000,
    0b00100000,
    0b00100000,
-   0b00100000,    //letter T
+   0b00100000),    //letter T
 
+   SDA5708_GLYPH(
    0b10001000,
    0b10001000,
    0b10001000,
    0b10001000,
    0b10001000,
    0b10001000,
-   0b01110000,    //letter U
+   0b01110000),    //letter U
 
+   SDA5708_GLYPH(
    0b10001000,
    0b10001000,
    0b10001000,
    0b10001000,
    0b10001000,
    0b01010000,
-   0b00100000,    //letter V
+   0b00100000),    //letter V
 
+   SDA5708_GLYPH(
    0b10001000,
    0b10001000,
    0b10001000,
    0b10001000,
    0b10101000,
    0b11011000,
-   0b10001000,    //letter W
+   0b10001000),    //letter W
 
+   SDA5708_GLYPH(
    0b10001000,
    0b10001000,
    0b01010000,
    0b00100000,
    0b01010000,
    0b10001000,
-   0b10001000,    //letter X
+   0b10001000),    //letter X
 
+   SDA5708_GLYPH(
    0b10001000,
    0b10001000,
    0b10001000,
    0b01010000,
    0b00100000,
    0b00100000,
-   0b00100000,    //letter Y
+   0b00100000),    //letter Y
 
+   SDA5708_GLYPH(
    0b11111000,
    0b00001000,
    0b00010000,
    0b00100000,
    0b01000000,
    0b10000000,
-   0b11111000,    //letter Z
+   0b11111000),    //letter Z
 //-----------------------------------End capital letters
+   SDA5708_GLYPH(
    0b11100000,
    0b10000000,
    0b10000000,
    0b10000000,
    0b10000000,
    0b10000000,
-   0b11100000,    //letter [
+   0b11100000),    //letter [
 
+   SDA5708_GLYPH(
    0b00000000,
    0b10000000,
    0b01000000,
    0b00100000,
    0b00010000,
    0b00001000,
-   0b00000000,    //letter
+   0b00000000),    //letter backslash
 
+   SDA5708_GLYPH(
    0b00111000,
    0b00001000,
    0b00001000,
    0b00001000,
    0b00001000,
    0b00001000,
-   0b00111000,    //letter ]
+   0b00111000),    //letter ]
 
+   SDA5708_GLYPH(
    0b00100000,
    0b01010000,
    0b10001000,
    0b00000000,
    0b00000000,
    0b00000000,
-   0b00000000,    //letter ^
+   0b00000000),    //letter ^
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b00000000,
    0b00000000,
    0b00000000,
    0b00000000,
-   0b11111000,    //letter _
+   0b11111000),    //letter _
 
+   SDA5708_GLYPH(
    0b00010000,
    0b00010000,
    0b00001000,
    0b00000000,
    0b00000000,
    0b00000000,
-   0b00000000,    //letter '
+   0b00000000),    //letter '
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b01110000,
    0b10001000,
    0b10001000,
    0b10011000,
-   0b01101000,    //letter a
+   0b01101000),    //letter a
 
+   SDA5708_GLYPH(
    0b10000000,
    0b10000000,
    0b11110000,
    0b10001000,
    0b10001000,
    0b10001000,
-   0b11110000,    //letter b
+   0b11110000),    //letter b
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b01111000,
    0b10000000,
    0b10000000,
    0b10000000,
-   0b01111000,    //letter c
+   0b01111000),    //letter c
 
+   SDA5708_GLYPH(
    0b00001000,
    0b00001000,
    0b01111000,
    0b10001000,
    0b10001000,
    0b10001000,
-   0b01111000,    //letter d
+   0b01111000),    //letter d
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b01110000,
    0b10001000,
    0b11111000,
    0b10000000,
-   0b01111000,    //letter e
+   0b01111000),    //letter e
 
+   SDA5708_GLYPH(
    0b00010000,
    0b00101000,
    0b01110000,
    0b00100000,
    0b00100000,
    0b00100000,
-   0b00100000,    //letter f
+   0b00100000),    //letter f
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b01110000,
    0b10001000,
    0b01111000,
    0b00001000,
-   0b01110000,    //letter g
+   0b01110000),    //letter g
 
+   SDA5708_GLYPH(
    0b10000000,
    0b10000000,
    0b11110000,
    0b10001000,
    0b10001000,
    0b10001000,
-   0b10001000,    //letter h
+   0b10001000),    //letter h
 
+   SDA5708_GLYPH(
    0b00100000,
    0b00000000,
    0b00100000,
    0b00100000,
    0b00100000,
    0b00100000,
-   0b00100000,    //letter i
+   0b00100000),    //letter i
 
+   SDA5708_GLYPH(
    0b00100000,
    0b00000000,
    0b00100000,
    0b00100000,
    0b00100000,
    0b10100000,
-   0b01000000,    //letter j
+   0b01000000),    //letter j
 
+   SDA5708_GLYPH(
    0b10000000,
    0b10000000,
    0b10001000,
    0b10010000,
    0b10100000,
    0b11010000,
-   0b10001000,    //letter k
+   0b10001000),    //letter k
 
+   SDA5708_GLYPH(
    0b00100000,
    0b00100000,
    0b00100000,
    0b00100000,
    0b00100000,
    0b00100000,
-   0b00100000,    //letter l
+   0b00100000),    //letter l
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b11010000,
    0b10101000,
    0b10101000,
    0b10101000,
-   0b10101000,    //letter m
+   0b10101000),    //letter m
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b10110000,
    0b11001000,
    0b10001000,
    0b10001000,
-   0b10001000,    //letter n
+   0b10001000),    //letter n
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b01110000,
    0b10001000,
    0b10001000,
    0b10001000,
-   0b01110000,    //letter o
+   0b01110000),    //letter o
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b11110000,
    0b10001000,
    0b11110000,
    0b10000000,
-   0b10000000,    //letter p
+   0b10000000),    //letter p
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b01111000,
    0b10001000,
    0b01111000,
    0b00001000,
-   0b00001000,    //letter q
+   0b00001000),    //letter q
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b10110000,
    0b11001000,
    0b10000000,
    0b10000000,
-   0b10000000,    //letter r
+   0b10000000),    //letter r
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b01111000,
    0b10000000,
    0b01110000,
    0b00001000,
-   0b11110000,    //letter s
+   0b11110000),    //letter s
 
+   SDA5708_GLYPH(
    0b00100000,
    0b00100000,
    0b01110000,
    0b00100000,
    0b00100000,
    0b00100000,
-   0b00110000,    //letter t
+   0b00110000),    //letter t
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b10001000,
    0b10001000,
    0b10001000,
    0b10011000,
-   0b01101000,    //letter u
+   0b01101000),    //letter u
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b10001000,
    0b10001000,
    0b10001000,
    0b01010000,
-   0b00100000,    //letter v
+   0b00100000),    //letter v
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b10001000,
    0b10001000,
    0b10101000,
    0b10101000,
-   0b01010000,    //letter w
+   0b01010000),    //letter w
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b10001000,
    0b01010000,
    0b00100000,
    0b01010000,
-   0b10001000,    //letter x
+   0b10001000),    //letter x
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b10001000,
    0b10001000,
    0b11111000,
    0b00001000,
-   0b01110000,    //letter y
+   0b01110000),    //letter y
 
+   SDA5708_GLYPH(
    0b00000000,
    0b00000000,
    0b11111000,
    0b00010000,
    0b00100000,
    0b01000000,
-   0b11111000,    //letter z
+   0b11111000),    //letter z
 
+   SDA5708_GLYPH(
    0b00100000,
    0b01000000,
    0b01000000,
    0b10000000,
    0b01000000,
    0b01000000,
-   0b00100000,    //letter {
+   0b00100000),    //letter {
 
+   SDA5708_GLYPH(
    0b00100000,
    0b00100000,
    0b00100000,
    0b00000000,
    0b00100000,
    0b00100000,
-   0b00100000,    //letter |
+   0b00100000),    //letter |
 
+   SDA5708_GLYPH(
    0b00100000,
    0b00010000,
    0b00010000,
    0b00001000,
    0b00010000,
    0b00010000,
-   0b00100000,    //letter }
+   0b00100000),    //letter }
 
+   SDA5708_GLYPH(
    0b01010000,
    0b10100000,
    0b00000000,
    0b00000000,
    0b00000000,
    0b00000000,
-   0b00000000,    //letter ~
+   0b00000000),    //letter ~
 
+   SDA5708_GLYPH(
    0b11000000,
    0b11000000,
    0b00011111,
    0b00100000,
    0b00100000,
    0b00100000,
-   0b00011111    //letter *C [127]
+   0b00011111)    //letter *C [127]
 
 };
 
@@ -0,0 +1,138 @@
+#pragma once
+#include <stdint.h>
+
+// Cooperative scheduler over a static task table. run() starts at most one
+// task per call, the due task with the lowest priority value, so the caller
+// can service I/O between tasks and sleep when nothing is due.
+
+typedef void (*TaskCallback)(void);
+
+struct Task
+{
+    TaskCallback callback;
+    uint32_t interval;      // ms between deadlines
+    uint8_t priority;       // lower value runs first when several tasks are due
+    uint32_t deadline;
+    uint16_t maxLateness;   // worst start delay behind the deadline, ms
+    uint16_t overruns;      // starts that missed at least one whole interval
+};
+
+#define SCHEDULER_TASK(callback, interval, priority) { callback, interval, priority, 0, 0, 0 }
+#define SCHEDULER_IDLE 0xff
+
+#ifdef SCHEDULER_HOOKS
+// defined by the build that sets SCHEDULER_HOOKS, called around every task
+void schedulerTaskStart(uint8_t index);
+void schedulerTaskEnd(uint8_t index);
+#endif
+
+// A task table assembled by constexpr code, for task lists that depend on a
+// template parameter.
+template <uint8_t N>
+struct TaskTable
+{
+    Task tasks[N];
+    uint8_t size;
+
+    constexpr void add(TaskCallback callback, uint32_t interval, uint8_t priority)
+    {
+        tasks[size++] = SCHEDULER_TASK(callback, interval, priority);
+    }
+};
+
+class Scheduler {
+    Task *tasks;
+    uint8_t count;
+    uint8_t current;
+    volatile uint8_t *traceSlot;
+
+public:
+    Scheduler(Task *tasks, uint8_t count)
+        : tasks(tasks), count(count), current(SCHEDULER_IDLE), traceSlot(0) {
+    }
+
+    // also write the running task index to *slot, e.g. to RAM that survives
+    // a watchdog reset
+    void trace(volatile uint8_t *slot)
+    {
+        traceSlot = slot;
+    }
+
+    void start(uint32_t now)
+    {
+        for (uint8_t i = 0; i < count; i++) {
+            tasks[i].deadline = now + tasks[i].interval;
+            tasks[i].maxLateness = 0;
+            tasks[i].overruns = 0;
+        }
+    }
+
+    // run the most urgent due task; returns 0 if a task ran, otherwise the
+    // number of ms until the next deadline
+    uint32_t run(uint32_t now)
+    {
+        Task *next = 0;
+        uint8_t index = 0;
+        uint32_t wait = UINT32_MAX;
+
+        for (uint8_t i = 0; i < count; i++) {
+            int32_t left = (int32_t)(tasks[i].deadline - now);
+            if (left <= 0) {
+                if (!next || tasks[i].priority < next->priority) {
+                    next = &tasks[i];
+                    index = i;
+                }
+            } else if ((uint32_t)left < wait) {
+                wait = left;
+            }
+        }
+        if (!next) return wait;
+
+        uint32_t lateness = now - next->deadline;
+        if (lateness > next->maxLateness) {
+            next->maxLateness = lateness > UINT16_MAX ? UINT16_MAX : lateness;
+        }
+        if (lateness >= next->interval) {
+            // missed a whole period, resync instead of running back to back
+            if (next->overruns < UINT16_MAX) next->overruns++;
+            next->deadline = now + next->interval;
+        } else {
+            next->deadline += next->interval;
+        }
+
+        current = index;
+        if (traceSlot) *traceSlot = index;
+#ifdef SCHEDULER_HOOKS
+        schedulerTaskStart(index);
+        next->callback();
+        schedulerTaskEnd(index);
+#else
+        next->callback();
+#endif
+        current = SCHEDULER_IDLE;
+        if (traceSlot) *traceSlot = SCHEDULER_IDLE;
+        return 0;
+    }
+
+    // move a task's next deadline, e.g. to run it early on request
+    void reschedule(uint8_t index, uint32_t deadline)
+    {
+        tasks[index].deadline = deadline;
+    }
+
+    // index of the task being run, SCHEDULER_IDLE outside of a task
+    uint8_t running() const
+    {
+        return current;
+    }
+
+    uint8_t size() const
+    {
+        return count;
+    }
+
+    const Task &task(uint8_t index) const
+    {
+        return tasks[index];
+    }
+};
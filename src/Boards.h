@@ -0,0 +1,55 @@
+#pragma once
+#include <Arduino.h>
+
+// Compile-time board configurations for FanController. A platformio.ini
+// environment picks one with -DBOARD_CONFIG=<name>; everything a board does
+// not use is left out of its build.
+//
+// Timer2 belongs to the Modbus framer, so the PWM outputs are 9 and 10
+// (timer1), then 5 and 6 (timer0). Several OneWire buses must share a port,
+// they are driven in lockstep.
+
+struct SingleFanBoard
+{
+  static constexpr uint8_t oneWireBuses = 1;
+  static constexpr uint8_t oneWirePins[oneWireBuses] = { 3 };
+  static constexpr uint8_t maxSensors = 2;
+  static constexpr uint8_t fanChannels = 1;
+  static constexpr uint8_t pwmPins[fanChannels] = { 9 };
+  static constexpr uint8_t pwmMinDutyCycle = 25;
+  static constexpr uint8_t pwmMaxDutyCycle = 255;
+  static constexpr uint16_t registerBase = 0x00;
+  static constexpr bool display = false;
+};
+
+// SDA5708 on LOAD 4, DATA 5, CLOCK 6, RESET 7
+struct SingleFanDisplayBoard : SingleFanBoard
+{
+  static constexpr bool display = true;
+  static constexpr uint8_t displayLoad = 4;
+  static constexpr uint8_t displayData = 5;
+  static constexpr uint8_t displayClock = 6;
+  static constexpr uint8_t displayReset = 7;
+};
+
+// one sensor per fan, each on its own bus: channel n follows the sensor on
+// A<n>, a failed read there runs only that channel at full speed
+struct QuadFanBoard : SingleFanBoard
+{
+  static constexpr uint8_t oneWireBuses = 4;
+  static constexpr uint8_t oneWirePins[oneWireBuses] = { A0, A1, A2, A3 };
+  static constexpr uint8_t maxSensors = 4;
+  static constexpr uint8_t fanChannels = 4;
+  static constexpr uint8_t pwmPins[fanChannels] = { 9, 10, 5, 6 };
+};
+
+// pins 5 and 6 drive fans and A0-A3 the buses here, the display moves to
+// 3, 4, 7 and 8
+struct QuadFanDisplayBoard : QuadFanBoard
+{
+  static constexpr bool display = true;
+  static constexpr uint8_t displayLoad = 3;
+  static constexpr uint8_t displayData = 4;
+  static constexpr uint8_t displayClock = 7;
+  static constexpr uint8_t displayReset = 8;
+};
@@ -0,0 +1,930 @@
+#pragma once
+#include <Arduino.h>
+#include <OneWire.h>
+#include <DallasTemperature.h>
+#include <Ds18Search.h>
+#include <Ds18Bank.h>
+#include <Scheduler.h>
+#include <FanControl.h>
+#include <RtuFramer.h>
+#include <ModbusSlave.h>
+#include <SDA5708.h>
+#include <MemoryStats.h>
+#include <ResetRecord.h>
+#include <avr/wdt.h>
+#include <avr/sleep.h>
+#include <EEPROM.h>
+#include "FanRegisters.h"
+
+#define TEMP_SENSOR_RESOLUTION 12
+#define TEMP_CONVERSION_TIME (750 / (1 << (12 - TEMP_SENSOR_RESOLUTION)))
+#define SENSOR_READ_RETRIES 3 // per reading cycle, shared by all sensors
+#define SENSOR_SEARCH_INTERVAL 10000UL
+#define SENSOR_SEARCH_STEP_MS 20 // idle time needed for one search step
+#define SAMPLE_ALIGN_US 5000 // requested conversions start this long after the frame
+#define FEED_FORWARD_MAX_LOOK_AHEAD 600
+#define AUTOTUNE_START 1 // autotune commands
+#define AUTOTUNE_ABORT 2
+#define AUTOTUNE_DEFAULT_LIMIT 10 // C above the setpoint that ends the experiment
+#define AUTOTUNE_TIMEOUT 7200000UL
+#define LAST_DUTY_SAVE_DELTA 32
+#define LAST_DUTY_SAVE_INTERVAL 600000UL
+#define EEPROM_ADDR_LAST_DUTY 64 // one byte per fan channel
+#define EEPROM_ADDR_SENSOR_ROMS 72 // 8 bytes per sensor slot
+#define EEPROM_ADDR_TUNE 104 // ultimate gain and period of the last autotune
+#define EEPROM_ADDR_USAGE 128
+#define USAGE_CHECKPOINT_MAX_SLOTS 8
+#define USAGE_CHECKPOINT_INTERVAL 1800000UL
+#define RS485_DE_PIN 2
+#define MODBUS_BAUD_RATE 9600
+#define MODBUS_DEFAULT_SLAVE_ADDR 20
+#define CONFIG_HASH "gtrfdokyp"
+#define CONFIG_STAGE_APPLY 1 // commit commands
+#define CONFIG_STAGE_DISCARD 2
+#define CONFIG_STAGE_IDLE 0 // stage status: the stage mirrors the settings
+#define CONFIG_STAGE_PENDING 1 // written, not committed yet
+#define CONFIG_STAGE_APPLIED 2
+#define CONFIG_STAGE_REJECTED_BAND 3 // hysteresis above the threshold, nothing applied
+#define DISPLAY_REFRESH_INTERVAL 50
+#define DISPLAY_PAGE_INTERVAL 2000
+#define DISPLAY_FLUSH_BUDGET_US 1000
+
+#define TASK_READ_TEMPERATURES 0
+#define TASK_ADJUST_FAN_SPEED 1
+#define TASK_CHECKPOINT_USAGE 2
+#define TASK_UPDATE_DISPLAY 3
+
+struct Config
+{
+  char hash[10];
+  uint8_t tempThreshold;
+  uint8_t tempHysteresis;
+  int16_t modbusSlaveAddr;
+  uint8_t groupId; // appended, reads as 0xff from configs written before it existed
+  uint16_t feedForwardLookAhead; // seconds, 0 disables feed-forward
+};
+
+// outcome of the last successful autotune, kept apart from the settings
+struct TuneResult
+{
+  uint16_t ultimateGain; // duty counts per C
+  uint16_t ultimatePeriod; // s
+};
+
+// usage counters are checkpointed round robin over the checkpoint slots, the
+// valid one with the highest sequence number is the latest
+template <uint8_t Channels>
+struct UsageCheckpoint
+{
+  uint32_t sequence;
+  FanUsage usage[Channels];
+  uint8_t crc;
+};
+
+// The whole controller for one board configuration (see Boards.h). All state
+// is static so tasks and register callbacks stay plain function pointers;
+// only what the board uses gets instantiated.
+template <class Board>
+class FanController
+{
+  typedef UsageCheckpoint<Board::fanChannels> Checkpoint;
+
+  static constexpr uint8_t taskCount = Board::display ? 4 : 3;
+  static constexpr uint8_t usageSlots = min((E2END + 1 - EEPROM_ADDR_USAGE) / sizeof(Checkpoint), (size_t)USAGE_CHECKPOINT_MAX_SLOTS);
+  static constexpr uint16_t holdingCount = 8 + (Board::fanChannels > 1 ? Board::fanChannels : 0) + 8 + 8;
+  static constexpr uint16_t inputCount = Board::maxSensors * 2 + taskCount * 2 + 6 + Board::fanChannels * MODBUS_USAGE_REGISTERS + 6 + Board::maxSensors * 5 + 2 + Board::maxSensors * 2;
+  static constexpr uint16_t inputOffsetTaskStats = MODBUS_INPUT_OFFSET_TEMPERATURES + Board::maxSensors * 2;
+  static constexpr uint8_t sensorsPerBus = Board::maxSensors / Board::oneWireBuses;
+  static constexpr bool multiBus = Board::oneWireBuses > 1;
+
+  static constexpr bool busesSharePort()
+  {
+    for (uint8_t bus = 1; bus < Board::oneWireBuses; bus++) {
+      if (oneWireBankPort(Board::oneWirePins[bus]) != oneWireBankPort(Board::oneWirePins[0])) return false;
+    }
+    return true;
+  }
+
+  static constexpr uint16_t reg(uint16_t offset)
+  {
+    return Board::registerBase + offset;
+  }
+
+  // sensors are found by the search, then read through DallasTemperature on
+  // one bus or a Ds18Bank on several
+  static inline Ds18Search<Board::oneWireBuses, sensorsPerBus> search{Board::oneWirePins};
+  static inline OneWire oneWire{Board::oneWirePins[0]};
+  static inline DallasTemperature sensors{&oneWire};
+  static inline Ds18Bank<Board::oneWireBuses, sensorsPerBus> bank{Board::oneWirePins, search};
+  static inline SDA5708 display{Board::displayLoad, Board::displayData, Board::displayClock, Board::displayReset};
+
+  static inline float temperatures[Board::maxSensors];
+  static inline RateFilter temperatureRates[Board::maxSensors];
+  static inline uint8_t sensorsCount;
+  static inline uint16_t sensorErrors[Board::maxSensors]; // failed scratchpad reads
+  static inline uint8_t unconverted = 0; // slots found since the last conversion started
+  static inline uint8_t readFailed = 0;  // slots without a valid reading
+  static inline uint8_t sensorFaults = 0; // slots whose last read failed
+  static inline bool sensorsStarted = false;
+  static inline bool sweeping = false;
+  static inline unsigned long lastSweep = 0;
+  static inline bool temperaturesRead = false;
+  static inline float currentMainTemp = 0;
+  static inline float lastMainTemp = 0;
+  static inline bool tempSensError = false;
+  static inline uint8_t faultedChannels = 0; // held at full speed by a fault
+  static inline uint8_t fanSpeedPercent = 0; // the fastest channel
+  static inline uint8_t channelSpeedPercent[Board::fanChannels];
+  static inline bool configDirty = false;
+  static inline bool resetPending = false;
+  static inline uint16_t sampleTrigger = 0;
+  static inline uint16_t sampleRequested = 0; // sequence of the conversion to start
+  static inline uint32_t sampleFrameMicros = 0; // end of the frame that requested it
+  static inline uint16_t samplePending = 0; // sequence of the conversion in progress
+  static inline uint16_t sampleDelay = 0; // us from the end of its frame to the conversion
+  static inline uint16_t sampleSequence = 0; // of the latched sample
+  static inline uint16_t sampleDelayLatched = 0;
+  static inline float sampleTemperatures[Board::maxSensors];
+  static inline uint8_t savedDutyCycle[Board::fanChannels];
+  static inline unsigned long lastDutySave[Board::fanChannels];
+  static inline uint16_t firstPwmMicros = 0;
+  static inline uint32_t firstResponseMillis = 0;
+  static inline uint16_t stackHeadroom = 0;
+  static inline uint16_t freeRam = 0;
+  static inline uint16_t changeCounter = 0; // bumped when a temperature, fan speed, error or setting changes
+  static inline ResetReport lastReset;
+  static inline FanUsage fanUsage[Board::fanChannels];
+  static inline uint32_t usageSequence = 0;
+  static inline unsigned long lastAdjust = 0;
+  static inline Config cfg = {};
+  static inline Config stage = {}; // written through the stage registers
+  static inline uint8_t stageCommand = 0;
+  static inline uint8_t stageStatus = CONFIG_STAGE_IDLE;
+  static inline uint16_t stageCommits = 0;
+  static inline RelayTune tune;
+  static inline TuneResult tuned = {};
+  static inline uint8_t tuneCommand = 0;
+  static inline uint8_t tuneSetpoint = 0; // C, 0 for the temperature at the start
+  static inline uint8_t tuneLimit = AUTOTUNE_DEFAULT_LIMIT;
+  static inline uint8_t relayDuty = 0;
+  static inline ModbusSlave modbus;
+
+  static TaskTable<taskCount> taskTable;
+  static inline Scheduler scheduler{taskTable.tasks, taskCount};
+  static const RegisterTable<holdingCount> holdingRegisters;
+  static const RegisterTable<inputCount> inputRegisters;
+
+  static constexpr TaskTable<taskCount> buildTasks()
+  {
+    TaskTable<taskCount> table = {};
+    table.add(readTemperatures, TEMP_CONVERSION_TIME, 0);
+    table.add(adjustFanSpeed, 1000, 1);
+    table.add(checkpointUsage, USAGE_CHECKPOINT_INTERVAL, 3);
+    if constexpr (Board::display) {
+      table.add(updateDisplay, DISPLAY_REFRESH_INTERVAL, 2);
+    }
+    return table;
+  }
+
+  static constexpr RegisterTable<holdingCount> buildHoldingRegisters()
+  {
+    RegisterTable<holdingCount> map = {};
+    map.add(REGISTER_RW(reg(MODBUS_OFFSET_DEV_ADDR), REGISTER_I16, &cfg.modbusSlaveAddr, 1, 247, 0, slaveAddressChanged));
+    map.add(REGISTER_RW_BROADCAST(reg(MODBUS_OFFSET_MAX_TEMP), REGISTER_U8, &cfg.tempThreshold, 0, 125, thresholdValid, configChanged));
+    map.add(REGISTER_RW_BROADCAST(reg(MODBUS_OFFSET_TEMP_HYSTERESIS), REGISTER_U8, &cfg.tempHysteresis, 0, 125, hysteresisValid, configChanged));
+    map.add(REGISTER_RO(reg(MODBUS_OFFSET_FAN_SPEED), REGISTER_U8, &fanSpeedPercent));
+    map.add(REGISTER_RO(reg(MODBUS_OFFSET_ERROR), REGISTER_U8, &tempSensError));
+    map.add(REGISTER_RW(reg(MODBUS_OFFSET_GROUP), REGISTER_U8, &cfg.groupId, 0, MODBUS_MAX_GROUP, 0, groupChanged));
+    map.add(REGISTER_RW_BROADCAST(reg(MODBUS_OFFSET_SAMPLE_NOW), REGISTER_U16, &sampleTrigger, 0, 0xffff, 0, sampleNow));
+    map.add(REGISTER_RW(reg(MODBUS_OFFSET_FEED_FORWARD), REGISTER_U16, &cfg.feedForwardLookAhead, 0, FEED_FORWARD_MAX_LOOK_AHEAD, 0, configChanged));
+    if constexpr (Board::fanChannels > 1) {
+      for (uint8_t c = 0; c < Board::fanChannels; c++) {
+        map.add(REGISTER_RO(reg(MODBUS_OFFSET_CHANNEL_FAN_SPEED + c), REGISTER_U8, &channelSpeedPercent[c]));
+      }
+    }
+    static_assert(MODBUS_OFFSET_CHANNEL_FAN_SPEED + Board::fanChannels <= MODBUS_OFFSET_STAGE, "channel registers overlap the stage");
+    map.add(REGISTER_RW_BROADCAST(reg(MODBUS_OFFSET_STAGE + MODBUS_OFFSET_STAGE_MAX_TEMP), REGISTER_U8, &stage.tempThreshold, 0, 125, 0, stageChanged));
+    map.add(REGISTER_RW_BROADCAST(reg(MODBUS_OFFSET_STAGE + MODBUS_OFFSET_STAGE_TEMP_HYSTERESIS), REGISTER_U8, &stage.tempHysteresis, 0, 125, 0, stageChanged));
+    map.add(REGISTER_RW(reg(MODBUS_OFFSET_STAGE + MODBUS_OFFSET_STAGE_FEED_FORWARD), REGISTER_U16, &stage.feedForwardLookAhead, 0, FEED_FORWARD_MAX_LOOK_AHEAD, 0, stageChanged));
+    map.add(REGISTER_RW(reg(MODBUS_OFFSET_STAGE + MODBUS_OFFSET_STAGE_GROUP), REGISTER_U8, &stage.groupId, 0, MODBUS_MAX_GROUP, 0, stageChanged));
+    map.add(REGISTER_RW(reg(MODBUS_OFFSET_STAGE + MODBUS_OFFSET_STAGE_DEV_ADDR), REGISTER_I16, &stage.modbusSlaveAddr, 1, 247, 0, stageChanged));
+    map.add(REGISTER_RW_BROADCAST(reg(MODBUS_OFFSET_STAGE + MODBUS_OFFSET_STAGE_COMMIT), REGISTER_U8, &stageCommand, 0, CONFIG_STAGE_DISCARD, 0, stageCommit));
+    map.add(REGISTER_RO(reg(MODBUS_OFFSET_STAGE + MODBUS_OFFSET_STAGE_STATUS), REGISTER_U8, &stageStatus));
+    map.add(REGISTER_RO(reg(MODBUS_OFFSET_STAGE + MODBUS_OFFSET_STAGE_COMMITS), REGISTER_U16, &stageCommits));
+    map.add(REGISTER_RW(reg(MODBUS_OFFSET_TUNE + MODBUS_OFFSET_TUNE_COMMAND), REGISTER_U8, &tuneCommand, 0, AUTOTUNE_ABORT, 0, tuneCommanded));
+    map.add(REGISTER_RW(reg(MODBUS_OFFSET_TUNE + MODBUS_OFFSET_TUNE_SETPOINT), REGISTER_U8, &tuneSetpoint, 0, 100, 0, 0));
+    map.add(REGISTER_RW(reg(MODBUS_OFFSET_TUNE + MODBUS_OFFSET_TUNE_LIMIT), REGISTER_U8, &tuneLimit, 1, 25, 0, 0));
+    map.add(REGISTER_RO(reg(MODBUS_OFFSET_TUNE + MODBUS_OFFSET_TUNE_STATE), REGISTER_U8, &tune.state));
+    map.add(REGISTER_RO(reg(MODBUS_OFFSET_TUNE + MODBUS_OFFSET_TUNE_CYCLES), REGISTER_U8, &tune.cycles));
+    map.add(REGISTER_RO(reg(MODBUS_OFFSET_TUNE + MODBUS_OFFSET_TUNE_AMPLITUDE), REGISTER_U16, &tune.amplitude));
+    map.add(REGISTER_RO(reg(MODBUS_OFFSET_TUNE + MODBUS_OFFSET_TUNE_GAIN), REGISTER_U16, &tuned.ultimateGain));
+    map.add(REGISTER_RO(reg(MODBUS_OFFSET_TUNE + MODBUS_OFFSET_TUNE_PERIOD), REGISTER_U16, &tuned.ultimatePeriod));
+    return map;
+  }
+
+  static constexpr RegisterTable<inputCount> buildInputRegisters()
+  {
+    RegisterTable<inputCount> map = {};
+    for (uint8_t t = 0; t < Board::maxSensors; t++) {
+      map.addFloat(reg(MODBUS_INPUT_OFFSET_TEMPERATURES + t * 2), &temperatures[t]);
+    }
+    for (uint8_t t = 0; t < taskCount; t++) {
+      map.add(REGISTER_RO(reg(inputOffsetTaskStats + t * 2), REGISTER_U16, &taskTable.tasks[t].maxLateness));
+      map.add(REGISTER_RO(reg(inputOffsetTaskStats + t * 2 + 1), REGISTER_U16, &taskTable.tasks[t].overruns));
+    }
+    map.add(REGISTER_RO(reg(MODBUS_INPUT_OFFSET_DIAG + MODBUS_OFFSET_DIAG_FIRST_PWM_US), REGISTER_U16, &firstPwmMicros));
+    map.addU32(reg(MODBUS_INPUT_OFFSET_DIAG + MODBUS_OFFSET_DIAG_FIRST_RESPONSE_MS), &firstResponseMillis);
+    map.add(REGISTER_RO(reg(MODBUS_INPUT_OFFSET_DIAG + MODBUS_OFFSET_DIAG_STACK_HEADROOM), REGISTER_U16, &stackHeadroom));
+    map.add(REGISTER_RO(reg(MODBUS_INPUT_OFFSET_DIAG + MODBUS_OFFSET_DIAG_FREE_RAM), REGISTER_U16, &freeRam));
+    map.add(REGISTER_RO(reg(MODBUS_INPUT_OFFSET_DIAG + MODBUS_OFFSET_DIAG_CHANGE_COUNTER), REGISTER_U16, &changeCounter));
+    for (uint8_t c = 0; c < Board::fanChannels; c++) {
+      uint16_t offset = MODBUS_INPUT_OFFSET_USAGE + c * MODBUS_USAGE_REGISTERS;
+      map.addU32(reg(offset), &fanUsage[c].runtime);
+      map.addU32(reg(offset + 2), &fanUsage[c].dutyRuntime);
+      map.addU32(reg(offset + 4), &fanUsage[c].fullSpeedTime);
+      map.addU32(reg(offset + 6), &fanUsage[c].faultEvents);
+    }
+    map.add(REGISTER_RO(reg(MODBUS_INPUT_OFFSET_RESET + MODBUS_OFFSET_RESET_CAUSE), REGISTER_U8, &lastReset.cause));
+    map.add(REGISTER_RO(reg(MODBUS_INPUT_OFFSET_RESET + MODBUS_OFFSET_RESET_TASK), REGISTER_U8, &lastReset.task));
+    map.add(REGISTER_RO(reg(MODBUS_INPUT_OFFSET_RESET + MODBUS_OFFSET_RESET_FUNCTION), REGISTER_U8, &lastReset.function));
+    map.addU32(reg(MODBUS_INPUT_OFFSET_RESET + MODBUS_OFFSET_RESET_LOOPS), &lastReset.loops);
+    map.add(REGISTER_RO(reg(MODBUS_INPUT_OFFSET_RESET + MODBUS_OFFSET_RESET_COUNT), REGISTER_U16, &lastReset.resets));
+    for (uint8_t t = 0; t < Board::maxSensors; t++) {
+      map.addBytes(reg(MODBUS_INPUT_OFFSET_SENSOR_ROMS + t * 4), search.roms[t], 8);
+    }
+    for (uint8_t t = 0; t < Board::maxSensors; t++) {
+      map.add(REGISTER_RO(reg(MODBUS_INPUT_OFFSET_SENSOR_ERRORS + t), REGISTER_U16, &sensorErrors[t]));
+    }
+    map.add(REGISTER_RO(reg(MODBUS_INPUT_OFFSET_SAMPLE + MODBUS_OFFSET_SAMPLE_SEQUENCE), REGISTER_U16, &sampleSequence));
+    map.add(REGISTER_RO(reg(MODBUS_INPUT_OFFSET_SAMPLE + MODBUS_OFFSET_SAMPLE_DELAY), REGISTER_U16, &sampleDelayLatched));
+    for (uint8_t t = 0; t < Board::maxSensors; t++) {
+      map.addFloat(reg(MODBUS_INPUT_OFFSET_SAMPLE + MODBUS_OFFSET_SAMPLE_TEMPERATURES + t * 2), &sampleTemperatures[t]);
+    }
+    return map;
+  }
+
+public:
+  static void setup()
+  {
+    static_assert(Board::fanChannels <= Board::maxSensors || Board::fanChannels == 1, "every channel needs a sensor to follow");
+    static_assert(Board::maxSensors % Board::oneWireBuses == 0, "every bus needs the same number of sensor slots");
+    static_assert(busesSharePort(), "the OneWire buses must share a port");
+    static_assert(sizeof(Config) <= EEPROM_ADDR_LAST_DUTY, "config overlaps the last duty cycle in EEPROM");
+    static_assert(EEPROM_ADDR_LAST_DUTY + Board::fanChannels <= EEPROM_ADDR_SENSOR_ROMS, "last duty cycles overlap the sensor ROMs in EEPROM");
+    static_assert(EEPROM_ADDR_SENSOR_ROMS + sizeof(search.roms) <= EEPROM_ADDR_TUNE, "sensor ROMs overlap the autotune result in EEPROM");
+    static_assert(EEPROM_ADDR_TUNE + sizeof(TuneResult) <= EEPROM_ADDR_USAGE, "autotune result overlaps the usage checkpoints in EEPROM");
+    static_assert(usageSlots >= 2, "usage checkpoints need at least two EEPROM slots");
+    static_assert(inputOffsetTaskStats + taskCount * 2 <= MODBUS_INPUT_OFFSET_DIAG, "task stats overlap the diagnostics registers");
+    static_assert(MODBUS_INPUT_OFFSET_USAGE + Board::fanChannels * MODBUS_USAGE_REGISTERS <= MODBUS_INPUT_OFFSET_RESET, "usage counters overlap the reset registers");
+    static_assert(MODBUS_INPUT_OFFSET_SENSOR_ROMS + Board::maxSensors * 4 <= MODBUS_INPUT_OFFSET_SENSOR_ERRORS, "sensor ROMs overlap the sensor error counters");
+    static_assert(MODBUS_INPUT_OFFSET_SENSOR_ERRORS + Board::maxSensors <= MODBUS_INPUT_OFFSET_SAMPLE, "sensor error counters overlap the sample");
+    static_assert(registerMapValid(holdingRegisters), "holding registers must be sorted, without overlaps and with valid ranges");
+    static_assert(registerMapValid(inputRegisters), "input registers must be sorted, without overlaps and with valid ranges");
+
+    // drive the fans before anything slow runs: the last persisted duty cycle,
+    // or full speed while the EEPROM cell is still erased
+    for (uint8_t c = 0; c < Board::fanChannels; c++) {
+      savedDutyCycle[c] = EEPROM.read(EEPROM_ADDR_LAST_DUTY + c);
+      analogWrite(Board::pwmPins[c], savedDutyCycle[c]);
+    }
+    firstPwmMicros = min(micros(), 0xffffUL);
+    for (uint8_t c = 0; c < Board::fanChannels; c++) {
+      if (savedDutyCycle[c] >= Board::pwmMinDutyCycle) {
+        channelSpeedPercent[c] = fanPercent(savedDutyCycle[c], Board::pwmMinDutyCycle, Board::pwmMaxDutyCycle);
+      }
+      fanSpeedPercent = max(fanSpeedPercent, channelSpeedPercent[c]);
+    }
+
+    resetRecordBegin(lastReset);
+
+    RtuFramer.begin(MODBUS_BAUD_RATE, RS485_DE_PIN);
+
+    #ifdef DEBUG
+    delay(1000);
+    RtuFramer.println(F("MODBUS RS485 Fan Controller v.1.0.0"));
+    RtuFramer.print(F("Reset cause: "));
+    RtuFramer.print(lastReset.cause, HEX);
+    RtuFramer.print(F(" task: "));
+    RtuFramer.println(lastReset.task);
+    RtuFramer.print(F("Free RAM: "));
+    RtuFramer.println(memoryFree());
+    #endif
+
+    if constexpr (Board::display) {
+      display.begin();
+      display.brightness(0);
+      display.print("FAN CTRL");
+      display.flush();
+    }
+
+    readConfig();
+    if (strcmp(cfg.hash, CONFIG_HASH) != 0) {
+      setConfigDefaults();
+      writeConfig();
+    }
+    if (cfg.groupId > MODBUS_MAX_GROUP) {
+      cfg.groupId = 0;
+    }
+    if (cfg.feedForwardLookAhead > FEED_FORWARD_MAX_LOOK_AHEAD) {
+      cfg.feedForwardLookAhead = 0;
+    }
+    stage = cfg;
+
+    readUsage();
+    // sensors keep the slots they had before the reset
+    EEPROM.get(EEPROM_ADDR_SENSOR_ROMS, search.roms);
+    search.begin();
+    EEPROM.get(EEPROM_ADDR_TUNE, tuned);
+    if (tuned.ultimatePeriod == 0xffff) tuned = {};
+
+    modbus.begin(cfg.modbusSlaveAddr);
+    modbus.setGroup(cfg.groupId);
+    modbus.configureHoldingRegisters(holdingRegisters.defs, holdingCount);
+    modbus.configureInputRegisters(inputRegisters.defs, inputCount);
+
+    scheduler.trace(&resetRecord.task);
+    scheduler.start(millis());
+    // usage counts from here, not from power-on
+    lastAdjust = millis();
+    // the bus search and first conversion run from the scheduler, so Modbus
+    // is served while they are in progress
+    scheduler.reschedule(TASK_READ_TEMPERATURES, millis());
+    wdt_enable(WDTO_2S);
+  }
+
+  static void loop()
+  {
+    resetRecord.loops++;
+    uint32_t wait = scheduler.run(millis());
+    bool idle = wait > 0;
+    pollModbus();
+
+    // the sensor search only takes time nothing else is due in
+    if (sensorsStarted && wait >= SENSOR_SEARCH_STEP_MS) {
+      searchSensors();
+    }
+
+    // registers are written in place by pollModbus(), persist what changed
+    if (configDirty) {
+      configDirty = false;
+      writeConfig();
+    }
+    // a new slave address takes effect after a reset, once the response to
+    // the write has left the wire
+    if (resetPending && !RtuFramer.busy()) {
+      resetRecordRestart();
+    }
+
+    wdt_reset();
+
+    if (idle && !RtuFramer.available()) {
+      // idle sleep keeps timers and the UART running, the next timer0 tick or
+      // an RX interrupt wakes the CPU
+      set_sleep_mode(SLEEP_MODE_IDLE);
+      sleep_mode();
+    }
+  }
+
+private:
+  static void requestTemperatures(void)
+  {
+    if constexpr (multiBus) bank.requestTemperatures();
+    else sensors.requestTemperatures();
+    unconverted = 0;
+  }
+
+  static bool readScratchpad(uint8_t slot, uint8_t *scratchpad)
+  {
+    return sensors.readScratchPad(search.address(slot), scratchpad) && ds18ScratchpadValid(scratchpad);
+  }
+
+  static void startSensors(void)
+  {
+    if constexpr (multiBus) {
+      bank.begin();
+    } else {
+      sensors.begin();
+      sensors.setWaitForConversion(false); // makes it async
+    }
+    search.sweep();
+    lastSweep = millis();
+    sensorsChanged();
+
+    #ifdef DEBUG
+    RtuFramer.print(F("Found: "));
+    RtuFramer.print(sensorsCount);
+    RtuFramer.println(F(" temperature sensor(s)"));
+    #endif
+
+    requestTemperatures();
+  }
+
+  // one step of the background search, a sweep every SENSOR_SEARCH_INTERVAL
+  static void searchSensors(void)
+  {
+    if (!sweeping) {
+      if (millis() - lastSweep < SENSOR_SEARCH_INTERVAL) return;
+      sweeping = true;
+    }
+    if (search.step()) {
+      sweeping = false;
+      lastSweep = millis();
+    }
+    if (search.changed) sensorsChanged();
+  }
+
+  static void sensorsChanged(void)
+  {
+    // a new sensor holds its power-on value (85 C) until it converted once
+    for (uint8_t t = 0; t < Board::maxSensors; t++) {
+      if (!(search.changed & (1 << t))) continue;
+      temperatures[t] = DS18_DISCONNECTED;
+      temperatureRates[t].reset();
+      readFailed |= 1 << t;
+      if (search.present(t)) unconverted |= 1 << t;
+    }
+    if (search.changed) {
+      EEPROM.put(EEPROM_ADDR_SENSOR_ROMS, search.roms);
+      changeCounter++;
+    }
+    search.changed = 0;
+    sensorsCount = search.count();
+
+    if (sensorsCount == 0) {
+      #ifdef DEBUG
+      RtuFramer.println("Set max fan speed!");
+      #endif
+      tempSensError = true;
+    }
+  }
+
+  static void readTemperatures(void)
+  {
+    if (!sensorsStarted) {
+      sensorsStarted = true;
+      startSensors();
+      return;
+    }
+    if (sampleRequested) {
+      startSample();
+      return;
+    }
+
+    digitalWrite(LED_BUILTIN, !digitalRead(LED_BUILTIN));
+    currentMainTemp = -127;
+    float previous[Board::maxSensors];
+    bool previousError = tempSensError;
+    memcpy(previous, temperatures, sizeof(previous));
+    // the bank reads all buses at once, DallasTemperature one sensor at a
+    // time; either way a bad scratchpad is read again while retries last
+    uint8_t valid = 0;
+    uint8_t retries = SENSOR_READ_RETRIES;
+    if constexpr (multiBus) valid = bank.read(temperatures, sensorErrors, retries);
+    // any sensor that fails this time sets the error, no sensor at all too
+    tempSensError = sensorsCount == 0;
+    sensorFaults = 0;
+    for (int t = 0; t < Board::maxSensors; t++)
+    {
+      if (!search.present(t)) continue;
+      readFailed |= 1 << t;
+      if (unconverted & (1 << t)) {
+        temperatures[t] = DS18_DISCONNECTED;
+        continue;
+      }
+      bool connected;
+      if constexpr (multiBus) {
+        connected = valid & (1 << t);
+      } else {
+        uint8_t scratchpad[DS18_SCRATCHPAD_SIZE];
+        while (!(connected = readScratchpad(t, scratchpad))) {
+          if (sensorErrors[t] < UINT16_MAX) sensorErrors[t]++;
+          if (!retries) break;
+          retries--;
+        }
+        if (connected) temperatures[t] = ds18Celsius(scratchpad, search.address(t)[0]);
+      }
+      if (!connected){
+        #ifdef DEBUG
+        RtuFramer.print("Temp. sensor #");
+        RtuFramer.print(t + 1);
+        RtuFramer.println(" error");
+        #endif
+        temperatures[t] = -127;
+        temperatureRates[t].reset();
+        tempSensError = true;
+        sensorFaults |= 1 << t;
+      } else {
+        readFailed &= ~(1 << t);
+        temperatureRates[t].update(temperatures[t] * 100, millis());
+        if (temperatures[t] > currentMainTemp) {
+          currentMainTemp = temperatures[t];
+        }
+      }
+    }
+
+    if (memcmp(previous, temperatures, sizeof(previous)) || tempSensError != previousError) changeCounter++;
+    temperaturesRead = true;
+    if (samplePending) {
+      // the conversion sampleNow() started: latch it under its sequence
+      memcpy(sampleTemperatures, temperatures, sizeof(sampleTemperatures));
+      sampleSequence = samplePending;
+      sampleDelayLatched = sampleDelay;
+      samplePending = 0;
+      changeCounter++;
+    }
+    requestTemperatures();
+  }
+
+  static bool readable(uint8_t t)
+  {
+    return search.present(t) && !(readFailed & (1 << t));
+  }
+
+  // the temperature a channel acts on, looking ahead by the rate of rise:
+  // its own sensor on multi-channel boards while it reads, otherwise the
+  // hottest valid one; INT16_MIN without any
+  static int16_t controlTemperature(uint8_t channel)
+  {
+    if (Board::fanChannels > 1 && readable(channel)) {
+      return temperatures[channel] * 100 + feedForward(temperatureRates[channel].value(), cfg.feedForwardLookAhead);
+    }
+    int16_t controlTemp = INT16_MIN;
+    for (int t = 0; t < Board::maxSensors; t++) {
+      if (!readable(t)) continue;
+      int16_t temp = temperatures[t] * 100 + feedForward(temperatureRates[t].value(), cfg.feedForwardLookAhead);
+      if (temp > controlTemp) controlTemp = temp;
+    }
+    return controlTemp;
+  }
+
+  // a fault runs a channel at full speed: without any sensor, when its own
+  // sensor fails on multi-channel boards, when any does on a single channel
+  static bool channelFault(uint8_t channel)
+  {
+    if (sensorsCount == 0) return true;
+    if (Board::fanChannels > 1) return sensorFaults & (1 << channel);
+    return tempSensError;
+  }
+
+  static void adjustFanSpeed(void)
+  {
+    // keep the boot duty cycle until there is something to act on; the
+    // usage counters only integrate duty cycles set below
+    if (!tempSensError && !temperaturesRead) {
+      lastAdjust = millis();
+      return;
+    }
+
+    unsigned long now = millis();
+    uint16_t elapsed = min(now - lastAdjust, 60000UL);
+    lastAdjust = now;
+
+    if (tune.running()) runTune(now);
+
+    uint8_t previous[Board::fanChannels];
+    memcpy(previous, channelSpeedPercent, sizeof(previous));
+    fanSpeedPercent = 0;
+    for (uint8_t c = 0; c < Board::fanChannels; c++) {
+      long dutyCycle = Board::pwmMaxDutyCycle;
+      uint8_t bit = 1 << c;
+      bool fault = channelFault(c);
+      if (fault) {
+        if (!(faultedChannels & bit)) fanUsage[c].faultEvents++;
+      } else if (tune.running()) {
+        dutyCycle = relayDuty;
+      } else {
+        // full speed when no sensor reads
+        int16_t temperature = controlTemperature(c);
+        if (temperature != INT16_MIN) dutyCycle = fanDutyCycle(temperature, cfg.tempThreshold, cfg.tempHysteresis, Board::pwmMinDutyCycle, Board::pwmMaxDutyCycle);
+      }
+      faultedChannels = fault ? faultedChannels | bit : faultedChannels & ~bit;
+      channelSpeedPercent[c] = fanPercent(dutyCycle, Board::pwmMinDutyCycle, Board::pwmMaxDutyCycle);
+      fanSpeedPercent = max(fanSpeedPercent, channelSpeedPercent[c]);
+
+      analogWrite(Board::pwmPins[c], dutyCycle);
+      saveLastDutyCycle(c, dutyCycle);
+      fanUsageUpdate(fanUsage[c], dutyCycle, Board::pwmMaxDutyCycle, elapsed);
+    }
+    if (memcmp(previous, channelSpeedPercent, sizeof(previous))) changeCounter++;
+
+    #ifdef DEBUG
+    if (lastMainTemp != currentMainTemp) {
+      RtuFramer.print(F("PWM: "));
+      RtuFramer.print(fanSpeedPercent);
+      RtuFramer.print(F("% temp: "));
+      RtuFramer.print(currentMainTemp);
+      RtuFramer.println("st. C");
+    }
+    #endif
+    lastMainTemp = currentMainTemp;
+  }
+
+  // one relay step on the hottest sensor, every channel follows the relay
+  static void runTune(unsigned long now)
+  {
+    uint8_t cycles = tune.cycles;
+    if (tempSensError) {
+      tune.abort();
+    } else {
+      relayDuty = tune.update(currentMainTemp * 100, now);
+    }
+    if (tune.cycles != cycles) changeCounter++;
+    if (tune.running()) return;
+
+    changeCounter++;
+    if (tune.state != RELAY_TUNE_DONE) return;
+    tuned.ultimateGain = tune.ultimateGain;
+    tuned.ultimatePeriod = tune.ultimatePeriod;
+    EEPROM.put(EEPROM_ADDR_TUNE, tuned);
+    // the band must stay within the threshold, see stageCommit()
+    cfg.tempHysteresis = min(relayTuneHysteresis(tuned.ultimateGain, Board::pwmMinDutyCycle, Board::pwmMaxDutyCycle), cfg.tempThreshold);
+    cfg.feedForwardLookAhead = min(relayTuneLookAhead(tuned.ultimatePeriod), (uint16_t)FEED_FORWARD_MAX_LOOK_AHEAD);
+    configChanged();
+  }
+
+  static void saveLastDutyCycle(uint8_t channel, uint8_t dutyCycle)
+  {
+    // EEPROM cells wear out, persist only big changes and not too often
+    if (abs(dutyCycle - savedDutyCycle[channel]) < LAST_DUTY_SAVE_DELTA) return;
+    if (millis() - lastDutySave[channel] < LAST_DUTY_SAVE_INTERVAL) return;
+    EEPROM.update(EEPROM_ADDR_LAST_DUTY + channel, dutyCycle);
+    savedDutyCycle[channel] = dutyCycle;
+    lastDutySave[channel] = millis();
+  }
+
+  static void pollModbus(void)
+  {
+    uint8_t request[MODBUS_MAX_FRAME];
+    uint8_t response[MODBUS_MAX_FRAME];
+
+    // the receiver is off until the previous response has left the wire
+    if (RtuFramer.busy()) return;
+
+    uint8_t length = RtuFramer.receive(request, sizeof(request));
+    if (!length) return;
+    // only frames for this controller, before handling them, so a reset
+    // while handling one still names it
+    if (modbus.accepts(request, length)) resetRecord.function = request[1];
+    // sampled per request, which is also about as deep as the stack goes
+    stackHeadroom = memoryStackHeadroom();
+    freeRam = memoryFree();
+    length = modbus.handle(request, length, response, sizeof(response));
+    if (length) {
+      RtuFramer.send(response, length);
+      if (!firstResponseMillis) firstResponseMillis = millis();
+    }
+  }
+
+  static void updateDisplay(void)
+  {
+    // pages: one per sensor, fan speed and, only while set, the error code
+    uint8_t sensorPages = Board::maxSensors;
+    uint8_t pages = sensorPages + 1 + (tempSensError ? 1 : 0);
+    uint8_t page = (millis() / DISPLAY_PAGE_INTERVAL) % pages;
+    char text[9];
+
+    if (page < sensorPages) {
+      if (temperatures[page] == -127) {
+        snprintf(text, sizeof(text), "T%u   ---", page + 1);
+      } else {
+        // 8 characters: tenths up to 99.9 either way, whole degrees beyond
+        int tenths = temperatures[page] * 10;
+        char sign = tenths < 0 ? '-' : ' ';
+        tenths = abs(tenths);
+        if (tenths < 1000) {
+          snprintf(text, sizeof(text), "T%u%c%2d.%d\x7f", page + 1, sign, tenths / 10, tenths % 10);
+        } else {
+          snprintf(text, sizeof(text), "T%u%c%3d\x7f", page + 1, sign, min(tenths / 10, 999));
+        }
+      }
+    } else if (page == sensorPages) {
+      snprintf(text, sizeof(text), "FAN %3u%%", fanSpeedPercent);
+    } else {
+      snprintf(text, sizeof(text), "ERR %4u", tempSensError);
+    }
+    display.print(text);
+
+    // the SDA5708 is bit-banged, spread a redraw over several passes so it
+    // never holds off pollModbus() for long
+    display.flush(DISPLAY_FLUSH_BUDGET_US);
+  }
+
+  static void readUsage(void)
+  {
+    Checkpoint checkpoint;
+    for (uint8_t slot = 0; slot < usageSlots; slot++) {
+      EEPROM.get(EEPROM_ADDR_USAGE + slot * sizeof(checkpoint), checkpoint);
+      // erased or torn slots fail the crc
+      if (OneWire::crc8((const uint8_t *)&checkpoint, offsetof(Checkpoint, crc)) != checkpoint.crc) continue;
+      if (checkpoint.sequence == 0xffffffff) continue;
+      if (checkpoint.sequence >= usageSequence) {
+        usageSequence = checkpoint.sequence;
+        memcpy(fanUsage, checkpoint.usage, sizeof(fanUsage));
+      }
+    }
+  }
+
+  static void checkpointUsage(void)
+  {
+    // every slot takes one write in usageSlots, which spreads the EEPROM
+    // wear and leaves the previous checkpoint intact if power fails halfway
+    // through
+    Checkpoint checkpoint;
+    checkpoint.sequence = ++usageSequence;
+    memcpy(checkpoint.usage, fanUsage, sizeof(fanUsage));
+    checkpoint.crc = OneWire::crc8((const uint8_t *)&checkpoint, offsetof(Checkpoint, crc));
+    EEPROM.put(EEPROM_ADDR_USAGE + (checkpoint.sequence % usageSlots) * sizeof(checkpoint), checkpoint);
+  }
+
+  static void readConfig() {
+
+    int ee = 0;
+    byte* p = (byte*)(void*)&cfg;
+      unsigned int i;
+      for (i = 0; i < sizeof(cfg); i++)
+            *p++ = EEPROM.read(ee++);
+
+    #ifdef DEBUG
+    RtuFramer.println("READ");
+    RtuFramer.print("modbusSlaveAddr: ");
+    RtuFramer.println(cfg.modbusSlaveAddr);
+    RtuFramer.print("tempThreshold: ");
+    RtuFramer.println(cfg.tempThreshold);
+    RtuFramer.print("tempHysteresis:");
+    RtuFramer.println(cfg.tempHysteresis);
+    RtuFramer.print("hash: ");
+    RtuFramer.println(cfg.hash);
+    #endif
+  }
+
+  static void writeConfig() {
+
+    #ifdef DEBUG
+    RtuFramer.println("WRITE");
+    RtuFramer.print("modbusSlaveAddr: ");
+    RtuFramer.println(cfg.modbusSlaveAddr);
+    RtuFramer.print("tempThreshold: ");
+    RtuFramer.println(cfg.tempThreshold);
+    RtuFramer.print("tempHysteresis:");
+    RtuFramer.println(cfg.tempHysteresis);
+    RtuFramer.print("hash: ");
+    RtuFramer.println(cfg.hash);
+    #endif
+
+    int ee = 0;
+    const byte* p = (const byte*)(const void*)&cfg;
+      unsigned int i;
+      for (i = 0; i < sizeof(cfg); i++)
+            EEPROM.put(ee++, *p++);
+  }
+
+  static void setConfigDefaults() {
+    strcpy(cfg.hash, CONFIG_HASH);
+    cfg.tempThreshold = 30;
+    cfg.tempHysteresis = 5;
+    cfg.modbusSlaveAddr = MODBUS_DEFAULT_SLAVE_ADDR;
+    cfg.groupId = 0;
+    cfg.feedForwardLookAhead = 0;
+  }
+
+  static void configChanged(void)
+  {
+    configDirty = true;
+    changeCounter++;
+    stageFollow();
+  }
+
+  static void slaveAddressChanged(void)
+  {
+    configDirty = true;
+    resetPending = true;
+    stageFollow();
+  }
+
+  static void groupChanged(void)
+  {
+    configDirty = true;
+    changeCounter++;
+    modbus.setGroup(cfg.groupId);
+    stageFollow();
+  }
+
+  // the band as in stageCommit(): direct writes may not put the hysteresis
+  // above the threshold either, checked against the other register's value
+  // after the frame when it writes both
+  static bool thresholdValid(uint16_t value)
+  {
+    uint16_t hysteresis = cfg.tempHysteresis;
+    modbus.pending(reg(MODBUS_OFFSET_TEMP_HYSTERESIS), hysteresis);
+    return fanBandValid(value, hysteresis);
+  }
+
+  static bool hysteresisValid(uint16_t value)
+  {
+    uint16_t threshold = cfg.tempThreshold;
+    modbus.pending(reg(MODBUS_OFFSET_MAX_TEMP), threshold);
+    return fanBandValid(threshold, value);
+  }
+
+  // a direct write shows in the stage unless a master is working on it
+  static void stageFollow(void)
+  {
+    if (stageStatus == CONFIG_STAGE_IDLE || stageStatus == CONFIG_STAGE_APPLIED) {
+      stage = cfg;
+      stageStatus = CONFIG_STAGE_IDLE;
+    }
+  }
+
+  static void stageChanged(void)
+  {
+    stageStatus = CONFIG_STAGE_PENDING;
+  }
+
+  // apply the stage as one change: checked as a whole, one EEPROM write and
+  // at most one reset. A master writes the stage and the commit in a single
+  // FC16 frame, or with FC23 to read the status back in the same exchange.
+  static void stageCommit(void)
+  {
+    uint8_t command = stageCommand;
+    stageCommand = 0;
+    if (command == CONFIG_STAGE_DISCARD) {
+      stage = cfg;
+      stageStatus = CONFIG_STAGE_IDLE;
+      return;
+    }
+    if (!fanBandValid(stage.tempThreshold, stage.tempHysteresis)) {
+      stageStatus = CONFIG_STAGE_REJECTED_BAND;
+      return;
+    }
+    resetPending |= stage.modbusSlaveAddr != cfg.modbusSlaveAddr;
+    cfg = stage;
+    modbus.setGroup(cfg.groupId);
+    configDirty = true;
+    changeCounter++;
+    stageStatus = CONFIG_STAGE_APPLIED;
+    stageCommits++;
+  }
+
+  // the experiment starts from the current state of the enclosure: the
+  // setpoint should lie between the temperatures the load reaches with the
+  // fans stopped and at full speed
+  static void tuneCommanded(void)
+  {
+    uint8_t command = tuneCommand;
+    tuneCommand = 0;
+    if (command == AUTOTUNE_ABORT) {
+      if (tune.running()) changeCounter++;
+      tune.abort();
+      return;
+    }
+    if (tune.running()) return;
+    if (tempSensError || !temperaturesRead) {
+      tune.state = RELAY_TUNE_ABORTED;
+      return;
+    }
+    int16_t setpoint = tuneSetpoint ? tuneSetpoint * 100 : (int16_t)(currentMainTemp * 100);
+    tune.start(setpoint, setpoint + tuneLimit * 100, Board::pwmMaxDutyCycle, millis(), AUTOTUNE_TIMEOUT);
+    relayDuty = 0;
+    changeCounter++;
+  }
+
+  // start a conversion and read it as soon as it is done; the value written
+  // is the sequence the reading is latched under. A broadcast reaches every
+  // controller at the same moment, but loop() gets to it after whatever task
+  // is running: starting the conversion SAMPLE_ALIGN_US after the frame lines
+  // them up again. The read task starts it, due in the last millisecond
+  // before that point, so the frame's handling does not wait.
+  static void sampleNow(void)
+  {
+    uint16_t sequence = sampleTrigger;
+    sampleTrigger = 0;
+    if (!sensorsStarted) return;
+    sampleRequested = sequence;
+    sampleFrameMicros = RtuFramer.frameMicros();
+    uint32_t elapsed = micros() - sampleFrameMicros;
+    uint32_t ahead = elapsed < SAMPLE_ALIGN_US - 1000 ? (SAMPLE_ALIGN_US - 1000 - elapsed) / 1000 : 0;
+    scheduler.reschedule(TASK_READ_TEMPERATURES, millis() + ahead);
+  }
+
+  // from the read task: wait out the rest of SAMPLE_ALIGN_US, at most about
+  // a millisecond, and start the conversion
+  static void startSample(void)
+  {
+    uint32_t elapsed;
+    while ((elapsed = micros() - sampleFrameMicros) < SAMPLE_ALIGN_US) {}
+    requestTemperatures();
+    samplePending = sampleRequested;
+    sampleRequested = 0;
+    sampleDelay = min(elapsed, 0xffffUL);
+    scheduler.reschedule(TASK_READ_TEMPERATURES, millis() + TEMP_CONVERSION_TIME);
+  }
+};
+
+template <class Board>
+TaskTable<FanController<Board>::taskCount> FanController<Board>::taskTable = FanController<Board>::buildTasks();
+
+template <class Board>
+constexpr RegisterTable<FanController<Board>::holdingCount> FanController<Board>::holdingRegisters PROGMEM = FanController<Board>::buildHoldingRegisters();
+
+template <class Board>
+constexpr RegisterTable<FanController<Board>::inputCount> FanController<Board>::inputRegisters PROGMEM = FanController<Board>::buildInputRegisters();
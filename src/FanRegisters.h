@@ -0,0 +1,55 @@
+#pragma once
+
+// The Modbus register layout, offsets from a board's register base. Plain
+// defines, so that tools/fleet builds its requests from the same numbers as
+// the firmware's register maps.
+
+#define MODBUS_MAX_FRAME 64
+#define MODBUS_OFFSET_DEV_ADDR 0
+#define MODBUS_OFFSET_MAX_TEMP 1
+#define MODBUS_OFFSET_TEMP_HYSTERESIS 2
+#define MODBUS_OFFSET_FAN_SPEED 3
+#define MODBUS_OFFSET_ERROR 4
+#define MODBUS_OFFSET_GROUP 5
+#define MODBUS_OFFSET_SAMPLE_NOW 6
+#define MODBUS_OFFSET_FEED_FORWARD 7
+#define MODBUS_OFFSET_CHANNEL_FAN_SPEED 8 // one per channel, boards with more than one
+#define MODBUS_OFFSET_STAGE 16 // staged settings, applied together by a commit
+#define MODBUS_OFFSET_STAGE_MAX_TEMP 0
+#define MODBUS_OFFSET_STAGE_TEMP_HYSTERESIS 1
+#define MODBUS_OFFSET_STAGE_FEED_FORWARD 2
+#define MODBUS_OFFSET_STAGE_GROUP 3
+#define MODBUS_OFFSET_STAGE_DEV_ADDR 4
+#define MODBUS_OFFSET_STAGE_COMMIT 5
+#define MODBUS_OFFSET_STAGE_STATUS 6
+#define MODBUS_OFFSET_STAGE_COMMITS 7
+#define MODBUS_OFFSET_TUNE 24 // relay autotune
+#define MODBUS_OFFSET_TUNE_COMMAND 0
+#define MODBUS_OFFSET_TUNE_SETPOINT 1
+#define MODBUS_OFFSET_TUNE_LIMIT 2
+#define MODBUS_OFFSET_TUNE_STATE 3
+#define MODBUS_OFFSET_TUNE_CYCLES 4
+#define MODBUS_OFFSET_TUNE_AMPLITUDE 5
+#define MODBUS_OFFSET_TUNE_GAIN 6
+#define MODBUS_OFFSET_TUNE_PERIOD 7
+#define MODBUS_INPUT_OFFSET_TEMPERATURES 0 // 2 per sensor, then 2 per task
+#define MODBUS_INPUT_OFFSET_DIAG 16
+#define MODBUS_OFFSET_DIAG_FIRST_PWM_US 0
+#define MODBUS_OFFSET_DIAG_FIRST_RESPONSE_MS 1
+#define MODBUS_OFFSET_DIAG_STACK_HEADROOM 3
+#define MODBUS_OFFSET_DIAG_FREE_RAM 4
+#define MODBUS_OFFSET_DIAG_CHANGE_COUNTER 5
+#define MODBUS_INPUT_OFFSET_USAGE 24
+#define MODBUS_USAGE_REGISTERS 8
+#define MODBUS_INPUT_OFFSET_RESET 56 // after the usage of 4 channels
+#define MODBUS_OFFSET_RESET_CAUSE 0
+#define MODBUS_OFFSET_RESET_TASK 1
+#define MODBUS_OFFSET_RESET_FUNCTION 2
+#define MODBUS_OFFSET_RESET_LOOPS 3
+#define MODBUS_OFFSET_RESET_COUNT 5
+#define MODBUS_INPUT_OFFSET_SENSOR_ROMS 64 // 4 per sensor slot
+#define MODBUS_INPUT_OFFSET_SENSOR_ERRORS 80 // after the ROMs of 4 sensors
+#define MODBUS_INPUT_OFFSET_SAMPLE 88 // the last sample taken on request
+#define MODBUS_OFFSET_SAMPLE_SEQUENCE 0
+#define MODBUS_OFFSET_SAMPLE_DELAY 1
+#define MODBUS_OFFSET_SAMPLE_TEMPERATURES 2 // 2 per sensor
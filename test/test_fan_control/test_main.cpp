@@ -0,0 +1,314 @@
+#include <unity.h>
+#include <FanControl.h>
+
+// The control law with its rate feed-forward, the usage counters and the
+// relay-feedback experiment.
+// Temperatures in centi-degrees C, times in ms.
+
+#define MIN_DUTY 20
+#define MAX_DUTY 255
+
+#define SETPOINT 3000
+#define LIMIT 4000
+#define RELAY_DUTY 200
+#define TIMEOUT 3600000UL
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+// RATE_HISTORY readings of a steady rise, degrees * 100 per second
+static void warmUp(RateFilter &filter, int16_t perSecond)
+{
+    for (uint8_t i = 0; i < RATE_HISTORY; i++) filter.update(2000 + i * perSecond, i * 1000UL);
+}
+
+static void test_rate_warm_up(void)
+{
+    // no rate until a whole history spans the slope
+    RateFilter filter;
+    warmUp(filter, 100);
+    TEST_ASSERT_EQUAL_INT16(0, filter.value());
+
+    // 4 C over 4 s is 60 C/min, a quarter of it on the first estimate
+    filter.update(2400, 4000);
+    TEST_ASSERT_EQUAL_INT16(1500, filter.value());
+    for (uint32_t i = 5; i < 40; i++) filter.update(2000 + i * 100, i * 1000);
+    TEST_ASSERT_INT_WITHIN(3, 6000, filter.value());
+
+    filter.reset();
+    TEST_ASSERT_EQUAL_INT16(0, filter.value());
+    warmUp(filter, -100);
+    TEST_ASSERT_EQUAL_INT16(0, filter.value());
+    filter.update(1600, 4000);
+    TEST_ASSERT_EQUAL_INT16(-1500, filter.value());
+}
+
+static void test_rate_clamped(void)
+{
+    // 100 C in 4 ms, far beyond int16_t in centi-degrees per minute
+    RateFilter filter;
+    for (uint8_t i = 0; i < RATE_HISTORY; i++) filter.update(0, i);
+    filter.update(10000, RATE_HISTORY);
+    TEST_ASSERT_EQUAL_INT16(INT16_MAX / 4, filter.value());
+
+    filter.reset();
+    for (uint8_t i = 0; i < RATE_HISTORY; i++) filter.update(0, i);
+    filter.update(-10000, RATE_HISTORY);
+    TEST_ASSERT_EQUAL_INT16(INT16_MIN / 4, filter.value());
+}
+
+static void test_rate_same_time(void)
+{
+    // readings with no time between them leave the rate alone
+    RateFilter filter;
+    for (uint8_t i = 0; i < RATE_HISTORY; i++) filter.update(2000, 1000);
+    filter.update(5000, 1000);
+    TEST_ASSERT_EQUAL_INT16(0, filter.value());
+}
+
+static void test_feed_forward(void)
+{
+    // drift and cooling add nothing
+    TEST_ASSERT_EQUAL_INT16(0, feedForward(FEED_FORWARD_DEADBAND, 60));
+    TEST_ASSERT_EQUAL_INT16(0, feedForward(-600, 60));
+    TEST_ASSERT_EQUAL_INT16(0, feedForward(600, 0));
+    // the rate times the look-ahead
+    TEST_ASSERT_EQUAL_INT16(FEED_FORWARD_DEADBAND + 1, feedForward(FEED_FORWARD_DEADBAND + 1, 60));
+    TEST_ASSERT_EQUAL_INT16(300, feedForward(600, 30));
+    // at most FEED_FORWARD_MAX, without overflowing on the way
+    TEST_ASSERT_EQUAL_INT16(FEED_FORWARD_MAX, feedForward(1000, 60));
+    TEST_ASSERT_EQUAL_INT16(FEED_FORWARD_MAX, feedForward(INT16_MAX, 600));
+}
+
+static void test_duty_cycle(void)
+{
+    // off below 25 C, MIN_DUTY there, rising to MAX_DUTY at 30 C
+    TEST_ASSERT_EQUAL_UINT8(0, fanDutyCycle(2499, 30, 5, MIN_DUTY, MAX_DUTY));
+    TEST_ASSERT_EQUAL_UINT8(MIN_DUTY, fanDutyCycle(2500, 30, 5, MIN_DUTY, MAX_DUTY));
+    TEST_ASSERT_EQUAL_UINT8(137, fanDutyCycle(2750, 30, 5, MIN_DUTY, MAX_DUTY));
+    TEST_ASSERT_EQUAL_UINT8(254, fanDutyCycle(2999, 30, 5, MIN_DUTY, MAX_DUTY));
+    TEST_ASSERT_EQUAL_UINT8(MAX_DUTY, fanDutyCycle(3000, 30, 5, MIN_DUTY, MAX_DUTY));
+    TEST_ASSERT_EQUAL_UINT8(MAX_DUTY, fanDutyCycle(12500, 30, 5, MIN_DUTY, MAX_DUTY));
+    TEST_ASSERT_EQUAL_UINT8(0, fanDutyCycle(-1000, 30, 5, MIN_DUTY, MAX_DUTY));
+}
+
+static void test_duty_cycle_band_edges(void)
+{
+    // no band: off and full speed either side of the threshold
+    TEST_ASSERT_EQUAL_UINT8(0, fanDutyCycle(2999, 30, 0, MIN_DUTY, MAX_DUTY));
+    TEST_ASSERT_EQUAL_UINT8(MAX_DUTY, fanDutyCycle(3000, 30, 0, MIN_DUTY, MAX_DUTY));
+    // the widest band a valid configuration allows, down to 0 C
+    TEST_ASSERT_EQUAL_UINT8(0, fanDutyCycle(-1, 30, 30, MIN_DUTY, MAX_DUTY));
+    TEST_ASSERT_EQUAL_UINT8(MIN_DUTY, fanDutyCycle(0, 30, 30, MIN_DUTY, MAX_DUTY));
+    TEST_ASSERT_EQUAL_UINT8(MAX_DUTY, fanDutyCycle(0, 0, 0, MIN_DUTY, MAX_DUTY));
+}
+
+static void test_band_valid(void)
+{
+    TEST_ASSERT_TRUE(fanBandValid(30, 5));
+    TEST_ASSERT_TRUE(fanBandValid(30, 30));
+    TEST_ASSERT_TRUE(fanBandValid(0, 0));
+    TEST_ASSERT_FALSE(fanBandValid(30, 31));
+    TEST_ASSERT_FALSE(fanBandValid(0, 1));
+}
+
+static void test_fan_percent(void)
+{
+    TEST_ASSERT_EQUAL_UINT8(0, fanPercent(0, MIN_DUTY, MAX_DUTY));
+    TEST_ASSERT_EQUAL_UINT8(0, fanPercent(MIN_DUTY - 1, MIN_DUTY, MAX_DUTY));
+    TEST_ASSERT_EQUAL_UINT8(0, fanPercent(MIN_DUTY, MIN_DUTY, MAX_DUTY));
+    TEST_ASSERT_EQUAL_UINT8(50, fanPercent(138, MIN_DUTY, MAX_DUTY));
+    TEST_ASSERT_EQUAL_UINT8(100, fanPercent(MAX_DUTY, MIN_DUTY, MAX_DUTY));
+}
+
+static void test_usage_stopped(void)
+{
+    FanUsage usage {};
+    fanUsageUpdate(usage, 0, MAX_DUTY, 60000);
+    TEST_ASSERT_EQUAL_UINT32(0, usage.runtime);
+    TEST_ASSERT_EQUAL_UINT32(0, usage.dutyRuntime);
+    TEST_ASSERT_EQUAL_UINT32(0, usage.fullSpeedTime);
+    TEST_ASSERT_EQUAL_UINT16(0, usage.runtimeMs);
+}
+
+static void test_usage_full_speed(void)
+{
+    // remainders carry over, nothing is lost between ticks
+    FanUsage usage {};
+    fanUsageUpdate(usage, MAX_DUTY, MAX_DUTY, 600);
+    TEST_ASSERT_EQUAL_UINT32(0, usage.runtime);
+    TEST_ASSERT_EQUAL_UINT32(0, usage.fullSpeedTime);
+    fanUsageUpdate(usage, MAX_DUTY, MAX_DUTY, 600);
+    TEST_ASSERT_EQUAL_UINT32(1, usage.runtime);
+    TEST_ASSERT_EQUAL_UINT16(200, usage.runtimeMs);
+    TEST_ASSERT_EQUAL_UINT32(1, usage.dutyRuntime);
+    TEST_ASSERT_EQUAL_UINT32(200UL * MAX_DUTY, usage.dutyMs);
+    TEST_ASSERT_EQUAL_UINT32(1, usage.fullSpeedTime);
+    TEST_ASSERT_EQUAL_UINT16(200, usage.fullSpeedMs);
+
+    for (uint16_t i = 0; i < 1000; i++) fanUsageUpdate(usage, MAX_DUTY, MAX_DUTY, 1000);
+    TEST_ASSERT_EQUAL_UINT32(1001, usage.runtime);
+    TEST_ASSERT_EQUAL_UINT32(1001, usage.dutyRuntime);
+    TEST_ASSERT_EQUAL_UINT32(1001, usage.fullSpeedTime);
+}
+
+static void test_usage_partial_duty(void)
+{
+    // 128 of 255 for 2 s is a little over 1 s of full speed equivalent
+    FanUsage usage {};
+    fanUsageUpdate(usage, 128, MAX_DUTY, 1000);
+    TEST_ASSERT_EQUAL_UINT32(1, usage.runtime);
+    TEST_ASSERT_EQUAL_UINT32(0, usage.dutyRuntime);
+    fanUsageUpdate(usage, 128, MAX_DUTY, 1000);
+    TEST_ASSERT_EQUAL_UINT32(2, usage.runtime);
+    TEST_ASSERT_EQUAL_UINT32(1, usage.dutyRuntime);
+    TEST_ASSERT_EQUAL_UINT32(1000, usage.dutyMs);
+    TEST_ASSERT_EQUAL_UINT32(0, usage.fullSpeedTime);
+    TEST_ASSERT_EQUAL_UINT16(0, usage.fullSpeedMs);
+}
+
+// a triangle around the setpoint: 60 s period, 1.5 C either side, one
+// reading per second starting at the trough
+static int16_t triangle(uint32_t second)
+{
+    uint32_t phase = second % 60;
+    return SETPOINT - 150 + (phase < 30 ? phase : 60 - phase) * 10;
+}
+
+static void test_relay_tune_done(void)
+{
+    RelayTune tune;
+    TEST_ASSERT_EQUAL_UINT8(RELAY_TUNE_IDLE, tune.state);
+    tune.start(SETPOINT, LIMIT, RELAY_DUTY, 0, TIMEOUT);
+    TEST_ASSERT_TRUE(tune.running());
+
+    // stopped until the first crossing above the band, then the relay duty
+    TEST_ASSERT_EQUAL_UINT8(0, tune.update(triangle(0), 0));
+    TEST_ASSERT_EQUAL_UINT8(0, tune.update(triangle(17), 17000));
+    TEST_ASSERT_EQUAL_UINT8(RELAY_DUTY, tune.update(triangle(18), 18000));
+
+    uint32_t second = 19;
+    while (tune.running() && second < 600) {
+        tune.update(triangle(second), second * 1000);
+        second++;
+    }
+    // the first cycle settles, the next RELAY_TUNE_CYCLES are measured
+    TEST_ASSERT_EQUAL_UINT8(RELAY_TUNE_DONE, tune.state);
+    TEST_ASSERT_EQUAL_UINT32(18 + 60 * (RELAY_TUNE_SETTLE + RELAY_TUNE_CYCLES) + 1, second);
+    TEST_ASSERT_EQUAL_UINT8(RELAY_TUNE_SETTLE + RELAY_TUNE_CYCLES, tune.cycles);
+    TEST_ASSERT_EQUAL_UINT16(60, tune.ultimatePeriod);
+    TEST_ASSERT_EQUAL_UINT16(150, tune.amplitude);
+    // 4 d / (pi sqrt(a^2 - e^2)): d = 100 counts, a = 1.5 C, e = 0.25 C
+    TEST_ASSERT_EQUAL_UINT16(86, tune.ultimateGain);
+
+    // left at the relay duty once done
+    TEST_ASSERT_EQUAL_UINT8(RELAY_DUTY, tune.update(SETPOINT, second * 1000));
+    TEST_ASSERT_EQUAL_UINT8(RELAY_TUNE_DONE, tune.state);
+    tune.abort();
+    TEST_ASSERT_EQUAL_UINT8(RELAY_TUNE_DONE, tune.state);
+}
+
+static void test_relay_tune_settings(void)
+{
+    // a quarter of 86 counts per C over the 235 count duty range
+    TEST_ASSERT_EQUAL_UINT8(11, relayTuneHysteresis(86, MIN_DUTY, MAX_DUTY));
+    TEST_ASSERT_EQUAL_UINT8(1, relayTuneHysteresis(60000, MIN_DUTY, MAX_DUTY));
+    TEST_ASSERT_EQUAL_UINT8(UINT8_MAX, relayTuneHysteresis(1, MIN_DUTY, MAX_DUTY));
+    TEST_ASSERT_EQUAL_UINT8(UINT8_MAX, relayTuneHysteresis(0, MIN_DUTY, MAX_DUTY));
+    TEST_ASSERT_EQUAL_UINT16(7, relayTuneLookAhead(60));
+    TEST_ASSERT_EQUAL_UINT16(0, relayTuneLookAhead(7));
+}
+
+static void test_relay_tune_over_limit(void)
+{
+    RelayTune tune;
+    tune.start(SETPOINT, LIMIT, RELAY_DUTY, 0, TIMEOUT);
+    TEST_ASSERT_EQUAL_UINT8(RELAY_DUTY, tune.update(LIMIT - 1, 1000));
+    TEST_ASSERT_TRUE(tune.running());
+    TEST_ASSERT_EQUAL_UINT8(RELAY_DUTY, tune.update(LIMIT, 2000));
+    TEST_ASSERT_EQUAL_UINT8(RELAY_TUNE_OVER_LIMIT, tune.state);
+    TEST_ASSERT_FALSE(tune.running());
+    TEST_ASSERT_EQUAL_UINT16(0, tune.ultimateGain);
+
+    // stays over the limit, cooling at the relay duty
+    TEST_ASSERT_EQUAL_UINT8(RELAY_DUTY, tune.update(SETPOINT - 500, 3000));
+    TEST_ASSERT_EQUAL_UINT8(RELAY_TUNE_OVER_LIMIT, tune.state);
+}
+
+static void test_relay_tune_timed_out(void)
+{
+    // no oscillation: the enclosure stays below the setpoint
+    RelayTune tune;
+    tune.start(SETPOINT, LIMIT, RELAY_DUTY, 1000, TIMEOUT);
+    TEST_ASSERT_EQUAL_UINT8(0, tune.update(SETPOINT - 100, 1000 + TIMEOUT));
+    TEST_ASSERT_TRUE(tune.running());
+    TEST_ASSERT_EQUAL_UINT8(RELAY_DUTY, tune.update(SETPOINT - 100, 1001 + TIMEOUT));
+    TEST_ASSERT_EQUAL_UINT8(RELAY_TUNE_TIMED_OUT, tune.state);
+    TEST_ASSERT_EQUAL_UINT8(0, tune.cycles);
+
+    // across the millis() wrap
+    tune.start(SETPOINT, LIMIT, RELAY_DUTY, 0xfffff000UL, TIMEOUT);
+    tune.update(SETPOINT - 100, 0x1000);
+    TEST_ASSERT_TRUE(tune.running());
+    tune.update(SETPOINT - 100, TIMEOUT);
+    TEST_ASSERT_EQUAL_UINT8(RELAY_TUNE_TIMED_OUT, tune.state);
+}
+
+static void test_relay_tune_restart(void)
+{
+    RelayTune tune;
+    tune.start(SETPOINT, LIMIT, RELAY_DUTY, 0, TIMEOUT);
+    for (uint32_t second = 0; tune.running(); second++) tune.update(triangle(second), second * 1000);
+    TEST_ASSERT_EQUAL_UINT8(RELAY_TUNE_DONE, tune.state);
+    TEST_ASSERT_EQUAL_UINT16(86, tune.ultimateGain);
+
+    // a new start clears the previous result
+    tune.start(SETPOINT, LIMIT, RELAY_DUTY, 600000, TIMEOUT);
+    TEST_ASSERT_TRUE(tune.running());
+    TEST_ASSERT_EQUAL_UINT8(0, tune.cycles);
+    TEST_ASSERT_EQUAL_UINT16(0, tune.ultimateGain);
+    TEST_ASSERT_EQUAL_UINT16(0, tune.ultimatePeriod);
+    TEST_ASSERT_EQUAL_UINT16(0, tune.amplitude);
+}
+
+static void test_relay_tune_aborted(void)
+{
+    RelayTune tune;
+    tune.abort();
+    TEST_ASSERT_EQUAL_UINT8(RELAY_TUNE_IDLE, tune.state);
+
+    tune.start(SETPOINT, LIMIT, RELAY_DUTY, 0, TIMEOUT);
+    tune.update(SETPOINT + 100, 1000);
+    tune.abort();
+    TEST_ASSERT_EQUAL_UINT8(RELAY_TUNE_ABORTED, tune.state);
+    TEST_ASSERT_EQUAL_UINT8(RELAY_DUTY, tune.update(SETPOINT - 100, 2000));
+    TEST_ASSERT_EQUAL_UINT8(RELAY_TUNE_ABORTED, tune.state);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_rate_warm_up);
+    RUN_TEST(test_rate_clamped);
+    RUN_TEST(test_rate_same_time);
+    RUN_TEST(test_feed_forward);
+    RUN_TEST(test_duty_cycle);
+    RUN_TEST(test_duty_cycle_band_edges);
+    RUN_TEST(test_band_valid);
+    RUN_TEST(test_fan_percent);
+    RUN_TEST(test_usage_stopped);
+    RUN_TEST(test_usage_full_speed);
+    RUN_TEST(test_usage_partial_duty);
+    RUN_TEST(test_relay_tune_done);
+    RUN_TEST(test_relay_tune_settings);
+    RUN_TEST(test_relay_tune_over_limit);
+    RUN_TEST(test_relay_tune_timed_out);
+    RUN_TEST(test_relay_tune_restart);
+    RUN_TEST(test_relay_tune_aborted);
+    return UNITY_END();
+}
@@ -0,0 +1,544 @@
+#include <unity.h>
+#include <FanControl.h>
+#include <ModbusSlave.h>
+
+// ModbusSlave and the register maps over a small map laid out like the
+// firmware's: a threshold and hysteresis band checked across registers, a
+// stage applied by a commit register, read-only counters and input values.
+
+#define ADDRESS 5
+#define GROUP 2
+#define OTHER_GROUP 3
+
+#define STAGE_APPLY 1
+#define STAGE_APPLIED 2
+#define STAGE_REJECTED_BAND 3
+
+static uint8_t threshold;
+static uint8_t hysteresis;
+static uint16_t counter;
+static int16_t offset;
+static uint8_t stageThreshold;
+static uint8_t stageHysteresis;
+static uint8_t stageCommand;
+static uint8_t stageStatus;
+static uint8_t changes;
+static float temperature;
+static uint32_t uptime;
+
+static ModbusSlave slave;
+
+static bool thresholdValid(uint16_t value)
+{
+    uint16_t other = hysteresis;
+    slave.pending(1, other);
+    return fanBandValid(value, other);
+}
+
+static bool hysteresisValid(uint16_t value)
+{
+    uint16_t other = threshold;
+    slave.pending(0, other);
+    return fanBandValid(other, value);
+}
+
+static void changed(void)
+{
+    changes++;
+}
+
+static void stageCommit(void)
+{
+    uint8_t command = stageCommand;
+    stageCommand = 0;
+    if (command != STAGE_APPLY) return;
+    if (!fanBandValid(stageThreshold, stageHysteresis)) {
+        stageStatus = STAGE_REJECTED_BAND;
+        return;
+    }
+    threshold = stageThreshold;
+    hysteresis = stageHysteresis;
+    stageStatus = STAGE_APPLIED;
+}
+
+static constexpr RegisterDef holdingMap[] PROGMEM = {
+    REGISTER_RW_BROADCAST(0, REGISTER_U8, &threshold, 0, 125, thresholdValid, changed),
+    REGISTER_RW_BROADCAST(1, REGISTER_U8, &hysteresis, 0, 125, hysteresisValid, changed),
+    REGISTER_RO(2, REGISTER_U16, &counter),
+    REGISTER_RW(3, REGISTER_I16, &offset, (uint16_t)-500, 500, 0, changed),
+    REGISTER_RW(10, REGISTER_U8, &stageThreshold, 0, 125, 0, 0),
+    REGISTER_RW(11, REGISTER_U8, &stageHysteresis, 0, 125, 0, 0),
+    REGISTER_RW(12, REGISTER_U8, &stageCommand, 0, STAGE_APPLY, 0, stageCommit),
+    REGISTER_RO(13, REGISTER_U8, &stageStatus),
+};
+static_assert(registerMapValid(holdingMap), "holding register map");
+
+static constexpr RegisterDef inputMap[] PROGMEM = {
+    REGISTER_FLOAT(0, &temperature),
+    REGISTER_U32(2, &uptime),
+};
+static_assert(registerMapValid(inputMap), "input register map");
+
+static uint8_t request[64];
+static uint8_t requestLength;
+static uint8_t response[64];
+
+// start a request frame, then append its fields
+static void frame(uint8_t address, uint8_t function)
+{
+    request[0] = address;
+    request[1] = function;
+    requestLength = 2;
+}
+
+static void putByte(uint8_t value)
+{
+    request[requestLength++] = value;
+}
+
+static void putWord(uint16_t value)
+{
+    putByte(value >> 8);
+    putByte(value);
+}
+
+// append the CRC and hand the frame to the slave; the response length
+static uint8_t send(uint8_t size = sizeof(response))
+{
+    uint16_t crc = modbusCrc(request, requestLength);
+    putByte(crc);
+    putByte(crc >> 8);
+    return slave.handle(request, requestLength, response, size);
+}
+
+static uint8_t readRegisters(uint8_t function, uint16_t start, uint16_t count, uint8_t size = sizeof(response))
+{
+    frame(ADDRESS, function);
+    putWord(start);
+    putWord(count);
+    return send(size);
+}
+
+static uint8_t writeSingle(uint8_t address, uint16_t start, uint16_t value)
+{
+    frame(address, MODBUS_FC_WRITE_SINGLE_REGISTER);
+    putWord(start);
+    putWord(value);
+    return send();
+}
+
+static uint8_t writeMultiple(uint8_t address, uint16_t start, uint16_t count, const uint16_t *values)
+{
+    frame(address, MODBUS_FC_WRITE_MULTIPLE_REGISTERS);
+    putWord(start);
+    putWord(count);
+    putByte(count * 2);
+    for (uint16_t i = 0; i < count; i++) putWord(values[i]);
+    return send();
+}
+
+static uint8_t readWrite(uint16_t readStart, uint16_t readCount, uint16_t writeStart, uint16_t writeCount, const uint16_t *values)
+{
+    frame(ADDRESS, MODBUS_FC_READ_WRITE_MULTIPLE_REGISTERS);
+    putWord(readStart);
+    putWord(readCount);
+    putWord(writeStart);
+    putWord(writeCount);
+    putByte(writeCount * 2);
+    for (uint16_t i = 0; i < writeCount; i++) putWord(values[i]);
+    return send();
+}
+
+static uint16_t responseWord(uint8_t index)
+{
+    return response[3 + index * 2] << 8 | response[4 + index * 2];
+}
+
+// start address and value or quantity of a write response
+static uint16_t echoWord(uint8_t index)
+{
+    return response[2 + index * 2] << 8 | response[3 + index * 2];
+}
+
+static void assertResponse(uint8_t expected, uint8_t length)
+{
+    TEST_ASSERT_EQUAL_UINT8(expected, length);
+    TEST_ASSERT_EQUAL_HEX8(ADDRESS, response[0]);
+    TEST_ASSERT_EQUAL_HEX16(0, modbusCrc(response, length));
+}
+
+static void assertException(uint8_t function, uint8_t code, uint8_t length)
+{
+    assertResponse(5, length);
+    TEST_ASSERT_EQUAL_HEX8(0x80 | function, response[1]);
+    TEST_ASSERT_EQUAL_HEX8(code, response[2]);
+}
+
+void setUp(void)
+{
+    threshold = 30;
+    hysteresis = 5;
+    counter = 1234;
+    offset = -2;
+    stageThreshold = threshold;
+    stageHysteresis = hysteresis;
+    stageCommand = 0;
+    stageStatus = 0;
+    changes = 0;
+    temperature = 21.5f;
+    uptime = 0x12345678;
+    slave = ModbusSlave();
+    slave.begin(ADDRESS);
+    slave.setGroup(GROUP);
+    slave.configureHoldingRegisters(holdingMap, sizeof(holdingMap) / sizeof(holdingMap[0]));
+    slave.configureInputRegisters(inputMap, sizeof(inputMap) / sizeof(inputMap[0]));
+}
+
+void tearDown(void)
+{
+}
+
+static uint8_t byte0;
+static uint8_t byte1;
+static uint32_t wide;
+
+static void test_register_map_valid(void)
+{
+    static constexpr RegisterDef unsorted[] = { REGISTER_RO(1, REGISTER_U8, &byte0), REGISTER_RO(0, REGISTER_U8, &byte1) };
+    static constexpr RegisterDef duplicate[] = { REGISTER_RO(0, REGISTER_U8, &byte0), REGISTER_RO(0, REGISTER_U8, &byte1) };
+    static constexpr RegisterDef noData[] = { REGISTER_RO(0, REGISTER_U8, 0) };
+    static constexpr RegisterDef broadcastReadOnly[] = { { 0, REGISTER_U8, REGISTER_BROADCAST, &byte0, 0, 0xff, 0, 0 } };
+    static constexpr RegisterDef writableU32[] = {
+        { 0, REGISTER_U32_HI, REGISTER_WRITABLE, &wide, 0, 0xffff, 0, 0 },
+        { 1, REGISTER_U32_LO, REGISTER_WRITABLE, &wide, 0, 0xffff, 0, 0 },
+    };
+    static constexpr RegisterDef emptyRange[] = { REGISTER_RW(0, REGISTER_U8, &byte0, 10, 5, 0, 0) };
+    static constexpr RegisterDef emptySignedRange[] = { REGISTER_RW(0, REGISTER_I16, &offset, 5, (uint16_t)-5, 0, 0) };
+    static constexpr RegisterDef byteRange[] = { REGISTER_RW(0, REGISTER_U8, &byte0, 0, 256, 0, 0) };
+    static constexpr RegisterDef halfFloat[] = { REGISTER_RO(0, REGISTER_FLOAT_HI, &temperature) };
+    static constexpr RegisterDef splitFloat[] = {
+        REGISTER_RO(0, REGISTER_FLOAT_HI, &temperature),
+        REGISTER_RO(2, REGISTER_FLOAT_LO, &temperature),
+    };
+
+    TEST_ASSERT_TRUE(registerMapValid(holdingMap));
+    TEST_ASSERT_TRUE(registerMapValid(inputMap));
+    TEST_ASSERT_FALSE(registerMapValid(unsorted));
+    TEST_ASSERT_FALSE(registerMapValid(duplicate));
+    TEST_ASSERT_FALSE(registerMapValid(noData));
+    TEST_ASSERT_FALSE(registerMapValid(broadcastReadOnly));
+    TEST_ASSERT_FALSE(registerMapValid(writableU32));
+    TEST_ASSERT_FALSE(registerMapValid(emptyRange));
+    TEST_ASSERT_FALSE(registerMapValid(emptySignedRange));
+    TEST_ASSERT_FALSE(registerMapValid(byteRange));
+    TEST_ASSERT_FALSE(registerMapValid(halfFloat));
+    TEST_ASSERT_FALSE(registerMapValid(splitFloat));
+}
+
+static void test_register_table_filled(void)
+{
+    constexpr RegisterTable<3> full = [] {
+        RegisterTable<3> table {};
+        table.add(REGISTER_RO(0, REGISTER_U16, &counter));
+        table.addU32(1, &uptime);
+        return table;
+    }();
+    constexpr RegisterTable<3> partial = [] {
+        RegisterTable<3> table {};
+        table.addU32(1, &uptime);
+        return table;
+    }();
+
+    TEST_ASSERT_TRUE(registerMapValid(full));
+    TEST_ASSERT_FALSE(registerMapValid(partial));
+}
+
+static void test_register_accepts(void)
+{
+    RegisterDef def;
+    uint16_t value;
+
+    // clamped into the range, signed for I16
+    registerDef(holdingMap, 3, def);
+    value = (uint16_t)-1000;
+    TEST_ASSERT_TRUE(registerAccepts(def, value));
+    TEST_ASSERT_EQUAL_INT16(-500, (int16_t)value);
+    value = 600;
+    TEST_ASSERT_TRUE(registerAccepts(def, value));
+    TEST_ASSERT_EQUAL_INT16(500, (int16_t)value);
+    value = (uint16_t)-20;
+    TEST_ASSERT_TRUE(registerAccepts(def, value));
+    TEST_ASSERT_EQUAL_INT16(-20, (int16_t)value);
+
+    // the validator sees the clamped value
+    registerDef(holdingMap, 0, def);
+    value = 200;
+    TEST_ASSERT_TRUE(registerAccepts(def, value));
+    TEST_ASSERT_EQUAL_UINT16(125, value);
+    value = 4;
+    TEST_ASSERT_FALSE(registerAccepts(def, value));
+    value = 5;
+    TEST_ASSERT_TRUE(registerAccepts(def, value));
+
+    registerDef(holdingMap, 2, def);
+    value = 1;
+    TEST_ASSERT_FALSE(registerAccepts(def, value));
+}
+
+static void test_read_holding_registers(void)
+{
+    assertResponse(13, readRegisters(MODBUS_FC_READ_HOLDING_REGISTERS, 0, 4));
+    TEST_ASSERT_EQUAL_HEX8(MODBUS_FC_READ_HOLDING_REGISTERS, response[1]);
+    TEST_ASSERT_EQUAL_UINT8(8, response[2]);
+    TEST_ASSERT_EQUAL_UINT16(30, responseWord(0));
+    TEST_ASSERT_EQUAL_UINT16(5, responseWord(1));
+    TEST_ASSERT_EQUAL_UINT16(1234, responseWord(2));
+    TEST_ASSERT_EQUAL_HEX16(0xfffe, responseWord(3));
+}
+
+static void test_read_input_registers(void)
+{
+    // 32-bit values as raw bits, high word first
+    assertResponse(13, readRegisters(MODBUS_FC_READ_INPUT_REGISTERS, 0, 4));
+    TEST_ASSERT_EQUAL_HEX16(0x41ac, responseWord(0));
+    TEST_ASSERT_EQUAL_HEX16(0x0000, responseWord(1));
+    TEST_ASSERT_EQUAL_HEX16(0x1234, responseWord(2));
+    TEST_ASSERT_EQUAL_HEX16(0x5678, responseWord(3));
+}
+
+static void test_read_exceptions(void)
+{
+    assertException(MODBUS_FC_READ_HOLDING_REGISTERS, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE,
+                    readRegisters(MODBUS_FC_READ_HOLDING_REGISTERS, 0, 0));
+    // a gap, past the end of the map and unmapped
+    assertException(MODBUS_FC_READ_HOLDING_REGISTERS, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS,
+                    readRegisters(MODBUS_FC_READ_HOLDING_REGISTERS, 3, 2));
+    assertException(MODBUS_FC_READ_HOLDING_REGISTERS, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS,
+                    readRegisters(MODBUS_FC_READ_HOLDING_REGISTERS, 13, 2));
+    assertException(MODBUS_FC_READ_INPUT_REGISTERS, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS,
+                    readRegisters(MODBUS_FC_READ_INPUT_REGISTERS, 4, 1));
+    // more than fits in the response buffer
+    assertException(MODBUS_FC_READ_HOLDING_REGISTERS, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE,
+                    readRegisters(MODBUS_FC_READ_HOLDING_REGISTERS, 0, 4, 12));
+}
+
+static void test_unknown_function(void)
+{
+    frame(ADDRESS, 0x2b);
+    assertException(0x2b, MODBUS_EXCEPTION_ILLEGAL_FUNCTION, send());
+    frame(ADDRESS, 0x08);
+    putWord(0);
+    putWord(0x1234);
+    assertException(0x08, MODBUS_EXCEPTION_ILLEGAL_FUNCTION, send());
+}
+
+static void test_short_request(void)
+{
+    frame(ADDRESS, MODBUS_FC_READ_HOLDING_REGISTERS);
+    putWord(0);
+    assertException(MODBUS_FC_READ_HOLDING_REGISTERS, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, send());
+
+    // fewer values than the byte count announces
+    frame(ADDRESS, MODBUS_FC_WRITE_MULTIPLE_REGISTERS);
+    putWord(0);
+    putWord(2);
+    putByte(4);
+    putWord(40);
+    assertException(MODBUS_FC_WRITE_MULTIPLE_REGISTERS, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, send());
+    TEST_ASSERT_EQUAL_UINT8(30, threshold);
+
+    // byte count not matching the quantity
+    frame(ADDRESS, MODBUS_FC_WRITE_MULTIPLE_REGISTERS);
+    putWord(0);
+    putWord(1);
+    putByte(4);
+    putWord(40);
+    putWord(0);
+    assertException(MODBUS_FC_WRITE_MULTIPLE_REGISTERS, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, send());
+    TEST_ASSERT_EQUAL_UINT8(30, threshold);
+}
+
+static void test_write_single_register(void)
+{
+    uint8_t length = writeSingle(ADDRESS, 0, 40);
+    assertResponse(8, length);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(request, response, 6);
+    TEST_ASSERT_EQUAL_UINT8(40, threshold);
+    TEST_ASSERT_EQUAL_UINT8(1, changes);
+
+    // clamped, the echo carries the value as written
+    assertResponse(8, writeSingle(ADDRESS, 0, 200));
+    TEST_ASSERT_EQUAL_UINT16(200, echoWord(1));
+    TEST_ASSERT_EQUAL_UINT8(125, threshold);
+
+    // the same value again does not count as a change
+    assertResponse(8, writeSingle(ADDRESS, 0, 125));
+    TEST_ASSERT_EQUAL_UINT8(2, changes);
+}
+
+static void test_write_single_exceptions(void)
+{
+    assertException(MODBUS_FC_WRITE_SINGLE_REGISTER, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, writeSingle(ADDRESS, 2, 1));
+    assertException(MODBUS_FC_WRITE_SINGLE_REGISTER, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, writeSingle(ADDRESS, 5, 1));
+    assertException(MODBUS_FC_WRITE_SINGLE_REGISTER, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, writeSingle(ADDRESS, 13, 1));
+    // the threshold below the hysteresis
+    assertException(MODBUS_FC_WRITE_SINGLE_REGISTER, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, writeSingle(ADDRESS, 0, 4));
+    assertException(MODBUS_FC_WRITE_SINGLE_REGISTER, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, writeSingle(ADDRESS, 1, 31));
+    TEST_ASSERT_EQUAL_UINT16(1234, counter);
+    TEST_ASSERT_EQUAL_UINT8(30, threshold);
+    TEST_ASSERT_EQUAL_UINT8(5, hysteresis);
+    TEST_ASSERT_EQUAL_UINT8(0, changes);
+}
+
+static void test_write_multiple_registers(void)
+{
+    // valid together, though 38 is above the old threshold
+    const uint16_t band[] = { 40, 38 };
+    uint8_t length = writeMultiple(ADDRESS, 0, 2, band);
+    assertResponse(8, length);
+    TEST_ASSERT_EQUAL_HEX8(MODBUS_FC_WRITE_MULTIPLE_REGISTERS, response[1]);
+    TEST_ASSERT_EQUAL_UINT16(0, echoWord(0));
+    TEST_ASSERT_EQUAL_UINT16(2, echoWord(1));
+    TEST_ASSERT_EQUAL_UINT8(40, threshold);
+    TEST_ASSERT_EQUAL_UINT8(38, hysteresis);
+    TEST_ASSERT_EQUAL_UINT8(2, changes);
+
+    const uint16_t signedValue[] = { (uint16_t)-1000 };
+    assertResponse(8, writeMultiple(ADDRESS, 3, 1, signedValue));
+    TEST_ASSERT_EQUAL_INT16(-500, offset);
+}
+
+static void test_write_multiple_all_or_nothing(void)
+{
+    // each valid against the old value of the other, not together
+    const uint16_t crossed[] = { 10, 20 };
+    assertException(MODBUS_FC_WRITE_MULTIPLE_REGISTERS, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE,
+                    writeMultiple(ADDRESS, 0, 2, crossed));
+    // the read-only counter in the middle
+    const uint16_t span[] = { 40, 10, 1, 7 };
+    assertException(MODBUS_FC_WRITE_MULTIPLE_REGISTERS, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS,
+                    writeMultiple(ADDRESS, 0, 4, span));
+    TEST_ASSERT_EQUAL_UINT8(30, threshold);
+    TEST_ASSERT_EQUAL_UINT8(5, hysteresis);
+    TEST_ASSERT_EQUAL_INT16(-2, offset);
+    TEST_ASSERT_EQUAL_UINT8(0, changes);
+
+    uint16_t value;
+    TEST_ASSERT_FALSE(slave.pending(0, value));
+}
+
+static void test_read_write_applies_stage(void)
+{
+    // the commit runs before the read, which returns its status
+    const uint16_t stage[] = { 50, 8, STAGE_APPLY };
+    assertResponse(13, readWrite(10, 4, 10, 3, stage));
+    TEST_ASSERT_EQUAL_HEX8(MODBUS_FC_READ_WRITE_MULTIPLE_REGISTERS, response[1]);
+    TEST_ASSERT_EQUAL_UINT8(8, response[2]);
+    TEST_ASSERT_EQUAL_UINT16(50, responseWord(0));
+    TEST_ASSERT_EQUAL_UINT16(8, responseWord(1));
+    TEST_ASSERT_EQUAL_UINT16(0, responseWord(2));
+    TEST_ASSERT_EQUAL_UINT16(STAGE_APPLIED, responseWord(3));
+    TEST_ASSERT_EQUAL_UINT8(50, threshold);
+    TEST_ASSERT_EQUAL_UINT8(8, hysteresis);
+}
+
+static void test_read_write_rejects_stage(void)
+{
+    const uint16_t stage[] = { 10, 20, STAGE_APPLY };
+    assertResponse(13, readWrite(10, 4, 10, 3, stage));
+    TEST_ASSERT_EQUAL_UINT16(STAGE_REJECTED_BAND, responseWord(3));
+    TEST_ASSERT_EQUAL_UINT8(30, threshold);
+    TEST_ASSERT_EQUAL_UINT8(5, hysteresis);
+}
+
+static void test_read_write_exceptions(void)
+{
+    // a rejected write is not applied and nothing is read
+    const uint16_t crossed[] = { 10, 20 };
+    assertException(MODBUS_FC_READ_WRITE_MULTIPLE_REGISTERS, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE,
+                    readWrite(0, 2, 0, 2, crossed));
+    TEST_ASSERT_EQUAL_UINT8(30, threshold);
+    TEST_ASSERT_EQUAL_UINT8(5, hysteresis);
+
+    // a bad read range fails before the write
+    const uint16_t stage[] = { 50, 8, STAGE_APPLY };
+    assertException(MODBUS_FC_READ_WRITE_MULTIPLE_REGISTERS, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS,
+                    readWrite(20, 1, 10, 3, stage));
+    assertException(MODBUS_FC_READ_WRITE_MULTIPLE_REGISTERS, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE,
+                    readWrite(10, 0, 10, 3, stage));
+    assertException(MODBUS_FC_READ_WRITE_MULTIPLE_REGISTERS, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS,
+                    readWrite(10, 4, 12, 2, stage));
+    TEST_ASSERT_EQUAL_UINT8(30, stageThreshold);
+    TEST_ASSERT_EQUAL_UINT8(0, stageStatus);
+    TEST_ASSERT_EQUAL_UINT8(30, threshold);
+}
+
+static void test_ignored_frames(void)
+{
+    readRegisters(MODBUS_FC_READ_HOLDING_REGISTERS, 0, 1);
+    request[2] ^= 1;
+    TEST_ASSERT_EQUAL_UINT8(0, slave.handle(request, requestLength, response, sizeof(response)));
+    TEST_ASSERT_FALSE(slave.accepts(request, requestLength));
+
+    frame(ADDRESS + 1, MODBUS_FC_READ_HOLDING_REGISTERS);
+    putWord(0);
+    putWord(1);
+    TEST_ASSERT_EQUAL_UINT8(0, send());
+    TEST_ASSERT_FALSE(slave.accepts(request, requestLength));
+
+    TEST_ASSERT_EQUAL_UINT8(0, writeSingle(MODBUS_GROUP_ADDRESS_BASE + OTHER_GROUP, 0, 40));
+    TEST_ASSERT_EQUAL_UINT8(30, threshold);
+
+    frame(ADDRESS, MODBUS_FC_READ_HOLDING_REGISTERS);
+    TEST_ASSERT_EQUAL_UINT8(0, slave.handle(request, 3, response, sizeof(response)));
+}
+
+static void test_broadcast(void)
+{
+    // written, never answered
+    TEST_ASSERT_EQUAL_UINT8(0, writeSingle(MODBUS_BROADCAST_ADDRESS, 0, 40));
+    TEST_ASSERT_EQUAL_UINT8(40, threshold);
+    const uint16_t band[] = { 45, 10 };
+    TEST_ASSERT_EQUAL_UINT8(0, writeMultiple(MODBUS_GROUP_ADDRESS_BASE + GROUP, 0, 2, band));
+    TEST_ASSERT_EQUAL_UINT8(45, threshold);
+    TEST_ASSERT_EQUAL_UINT8(10, hysteresis);
+
+    // only registers flagged for it, and only writes
+    TEST_ASSERT_EQUAL_UINT8(0, writeSingle(MODBUS_BROADCAST_ADDRESS, 3, 7));
+    TEST_ASSERT_EQUAL_INT16(-2, offset);
+    frame(MODBUS_BROADCAST_ADDRESS, MODBUS_FC_READ_HOLDING_REGISTERS);
+    putWord(0);
+    putWord(1);
+    TEST_ASSERT_EQUAL_UINT8(0, send());
+
+    // the direct address still writes the rest
+    assertResponse(8, writeSingle(ADDRESS, 3, 7));
+    TEST_ASSERT_EQUAL_INT16(7, offset);
+
+    slave.setGroup(0);
+    TEST_ASSERT_EQUAL_UINT8(0, writeSingle(MODBUS_GROUP_ADDRESS_BASE + GROUP, 0, 50));
+    TEST_ASSERT_EQUAL_UINT8(45, threshold);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_register_map_valid);
+    RUN_TEST(test_register_table_filled);
+    RUN_TEST(test_register_accepts);
+    RUN_TEST(test_read_holding_registers);
+    RUN_TEST(test_read_input_registers);
+    RUN_TEST(test_read_exceptions);
+    RUN_TEST(test_unknown_function);
+    RUN_TEST(test_short_request);
+    RUN_TEST(test_write_single_register);
+    RUN_TEST(test_write_single_exceptions);
+    RUN_TEST(test_write_multiple_registers);
+    RUN_TEST(test_write_multiple_all_or_nothing);
+    RUN_TEST(test_read_write_applies_stage);
+    RUN_TEST(test_read_write_rejects_stage);
+    RUN_TEST(test_read_write_exceptions);
+    RUN_TEST(test_ignored_frames);
+    RUN_TEST(test_broadcast);
+    return UNITY_END();
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <stdint.h>
+
+// Just enough of the Arduino core for OneWireBank, over one modelled port:
+// pin n is port bit n, and the bus levels follow the mode (DDR) and output
+// (PORT) bits the way the pins drive them. The test moves time on, and its
+// devices with it, in delayMicroseconds().
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+extern volatile uint8_t portMode;
+extern volatile uint8_t portOut;
+extern volatile uint8_t portIn;
+
+inline uint8_t digitalPinToPort(uint8_t)
+{
+    return 0;
+}
+
+inline uint8_t digitalPinToBitMask(uint8_t pin)
+{
+    return 1 << pin;
+}
+
+inline volatile uint8_t *portModeRegister(uint8_t)
+{
+    return &portMode;
+}
+
+inline volatile uint8_t *portOutputRegister(uint8_t)
+{
+    return &portOut;
+}
+
+inline volatile uint8_t *portInputRegister(uint8_t)
+{
+    return &portIn;
+}
+
+inline void noInterrupts(void)
+{
+}
+
+inline void interrupts(void)
+{
+}
+
+void delayMicroseconds(unsigned int us);
@@ -0,0 +1,200 @@
+#include <unity.h>
+#include <string.h>
+#include "Arduino.h"
+// the bank's source over the modelled port in Arduino.h
+#include <OneWireBank.cpp>
+
+// OneWireBank against a port modelled at the pin level, one device per bus.
+// A device answers a reset low for at least 480 us with a presence pulse,
+// takes a bit from the level 30 us into each slot and, once it has a whole
+// command byte, answers the read slots that follow with its reply, pulling
+// the bus low for the first 30 us of the slot for a 0.
+
+#define BUSES 4
+#define ALL_BUSES 0x0f
+#define RESET_MIN 480
+#define PRESENCE_WAIT 30
+#define PRESENCE_LOW 120
+#define DEVICE_SAMPLE 30
+#define DEVICE_HOLD 30
+
+volatile uint8_t portMode;
+volatile uint8_t portOut;
+volatile uint8_t portIn;
+
+struct Device
+{
+    bool present;
+    bool stuckLow;              // a short, the bus never rises
+    bool masterLow;             // the master pulls the bus low
+    uint32_t fell;              // when it started to
+    uint32_t sampleAt;          // when to take the bit of this write slot
+    uint32_t presenceFrom;
+    uint8_t received[4];
+    uint8_t receivedBits;
+    uint8_t reply[2];
+    uint8_t sentBits;
+    bool holding;               // sending a 0 in this slot
+    uint8_t resets;
+};
+
+static const uint8_t pins[BUSES] = { 0, 1, 2, 3 };
+static Device devices[BUSES];
+static uint32_t now;
+static OneWireBank bank;
+
+static bool devicePulls(const Device &device)
+{
+    if (device.stuckLow) return true;
+    if (device.presenceFrom && now >= device.presenceFrom && now < device.presenceFrom + PRESENCE_LOW) return true;
+    return device.holding && now < device.fell + DEVICE_HOLD;
+}
+
+// one microsecond of every bus
+static void tick(void)
+{
+    now++;
+    for (uint8_t bus = 0; bus < BUSES; bus++) {
+        Device &device = devices[bus];
+        uint8_t bit = 1 << bus;
+        // an output bit high drives the bus high, even against a device
+        bool pulled = (portMode & bit) && !(portOut & bit);
+        if (pulled && !device.masterLow) {
+            device.masterLow = true;
+            device.fell = now;
+            device.holding = false;
+            device.sampleAt = 0;
+            if (device.present && device.receivedBits >= 8 && device.sentBits < 16) {
+                device.holding = !(device.reply[device.sentBits / 8] & (1 << device.sentBits % 8));
+                device.sentBits++;
+            } else if (device.present) {
+                device.sampleAt = now + DEVICE_SAMPLE;
+            }
+        } else if (!pulled && device.masterLow) {
+            device.masterLow = false;
+            if (device.present && now - device.fell >= RESET_MIN) {
+                device.presenceFrom = now + PRESENCE_WAIT;
+                device.receivedBits = 0;
+                device.sentBits = 0;
+                memset(device.received, 0, sizeof(device.received));
+                device.resets++;
+            }
+        }
+        bool low = pulled || devicePulls(device);
+        if (now == device.sampleAt && device.receivedBits < sizeof(device.received) * 8) {
+            // a reset also starts this way; the rising edge clears it again
+            if (!low) device.received[device.receivedBits / 8] |= 1 << device.receivedBits % 8;
+            device.receivedBits++;
+        }
+        if (low) {
+            portIn &= ~bit;
+        } else {
+            portIn |= bit;
+        }
+    }
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    while (us--) tick();
+}
+
+void setUp(void)
+{
+    now = 0;
+    memset(devices, 0, sizeof(devices));
+    for (uint8_t bus = 0; bus < BUSES; bus++) {
+        devices[bus].present = true;
+        devices[bus].reply[0] = 0x50 + bus;
+        devices[bus].reply[1] = 0x05 | bus << 4;
+    }
+    // as after power-up: inputs, the pull-ups hold the buses high
+    portMode = 0;
+    portOut = 0;
+    portIn = ALL_BUSES;
+    bank.begin(pins, BUSES);
+}
+
+void tearDown(void)
+{
+}
+
+// what OneWire::search() leaves behind on a bus: the pin an output, driven
+// high after the last bit
+static void searchedWithOneWire(uint8_t buses)
+{
+    portMode |= buses;
+    portOut |= buses;
+    delayMicroseconds(100);
+}
+
+static void test_reset_presence(void)
+{
+    devices[2].present = false;
+    TEST_ASSERT_EQUAL_HEX8(0x0b, bank.reset(ALL_BUSES));
+    TEST_ASSERT_EQUAL_UINT8(1, devices[0].resets);
+    TEST_ASSERT_EQUAL_HEX8(0x02, bank.reset(0x06));
+    TEST_ASSERT_EQUAL_HEX8(0, portMode);
+}
+
+static void test_reset_after_search(void)
+{
+    searchedWithOneWire(ALL_BUSES);
+    TEST_ASSERT_EQUAL_HEX8(ALL_BUSES, bank.reset(ALL_BUSES));
+    TEST_ASSERT_EQUAL_HEX8(0, portOut & ALL_BUSES);
+    for (uint8_t bus = 0; bus < BUSES; bus++) {
+        TEST_ASSERT_EQUAL_UINT8(1, devices[bus].resets);
+    }
+
+    // the background search between reads, on one bus
+    searchedWithOneWire(0x04);
+    TEST_ASSERT_EQUAL_HEX8(ALL_BUSES, bank.reset(ALL_BUSES));
+}
+
+static void test_read_after_search(void)
+{
+    const uint8_t commands[BUSES] = { 0x44, 0xbe, 0x55, 0xcc };
+    uint8_t replies[2][BUSES];
+
+    searchedWithOneWire(ALL_BUSES);
+    TEST_ASSERT_EQUAL_HEX8(ALL_BUSES, bank.reset(ALL_BUSES));
+    bank.write(ALL_BUSES, commands);
+    bank.read(ALL_BUSES, replies[0]);
+    bank.read(ALL_BUSES, replies[1]);
+    for (uint8_t bus = 0; bus < BUSES; bus++) {
+        TEST_ASSERT_EQUAL_HEX8(commands[bus], devices[bus].received[0]);
+        TEST_ASSERT_EQUAL_HEX8(devices[bus].reply[0], replies[0][bus]);
+        TEST_ASSERT_EQUAL_HEX8(devices[bus].reply[1], replies[1][bus]);
+    }
+}
+
+static void test_write_same_byte(void)
+{
+    TEST_ASSERT_EQUAL_HEX8(ALL_BUSES, bank.reset(ALL_BUSES));
+    bank.write(0x05, 0xcc);
+    TEST_ASSERT_EQUAL_HEX8(0xcc, devices[0].received[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xcc, devices[2].received[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, devices[1].receivedBits);
+    TEST_ASSERT_EQUAL_UINT8(0, devices[3].receivedBits);
+}
+
+static void test_stuck_bus(void)
+{
+    // a shorted bus drops out, the others go on
+    devices[1].stuckLow = true;
+    delayMicroseconds(1);
+    TEST_ASSERT_EQUAL_HEX8(0x0d, bank.reset(ALL_BUSES));
+    TEST_ASSERT_EQUAL_UINT8(0, devices[1].resets);
+    TEST_ASSERT_EQUAL_UINT8(1, devices[0].resets);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_reset_presence);
+    RUN_TEST(test_reset_after_search);
+    RUN_TEST(test_read_after_search);
+    RUN_TEST(test_write_same_byte);
+    RUN_TEST(test_stuck_bus);
+    return UNITY_END();
+}
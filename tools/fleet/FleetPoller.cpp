@@ -0,0 +1,464 @@
+#include "FleetPoller.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// --- register map -----------------------------------------------------------
+
+std::vector<RegisterSpan> FanLayout::mapped() const
+{
+    std::vector<RegisterSpan> spans = {
+        { FAN_FC_READ_HOLDING, (uint16_t)(base + MODBUS_OFFSET_DEV_ADDR), MODBUS_OFFSET_CHANNEL_FAN_SPEED },
+        { FAN_FC_READ_HOLDING, (uint16_t)(base + MODBUS_OFFSET_STAGE), MODBUS_OFFSET_STAGE_COMMITS + 1 },
+        { FAN_FC_READ_HOLDING, (uint16_t)(base + MODBUS_OFFSET_TUNE), MODBUS_OFFSET_TUNE_PERIOD + 1 },
+        { FAN_FC_READ_INPUT, (uint16_t)(base + MODBUS_INPUT_OFFSET_TEMPERATURES), (uint16_t)(sensors * 2 + tasks * 2) },
+        { FAN_FC_READ_INPUT, (uint16_t)(base + MODBUS_INPUT_OFFSET_DIAG), MODBUS_OFFSET_DIAG_CHANGE_COUNTER + 1 },
+        { FAN_FC_READ_INPUT, (uint16_t)(base + MODBUS_INPUT_OFFSET_USAGE), (uint16_t)(channels * MODBUS_USAGE_REGISTERS) },
+        { FAN_FC_READ_INPUT, (uint16_t)(base + MODBUS_INPUT_OFFSET_RESET), MODBUS_OFFSET_RESET_COUNT + 1 },
+        { FAN_FC_READ_INPUT, (uint16_t)(base + MODBUS_INPUT_OFFSET_SENSOR_ROMS), (uint16_t)(sensors * 4) },
+        { FAN_FC_READ_INPUT, (uint16_t)(base + MODBUS_INPUT_OFFSET_SENSOR_ERRORS), sensors },
+        { FAN_FC_READ_INPUT, (uint16_t)(base + MODBUS_INPUT_OFFSET_SAMPLE), (uint16_t)(MODBUS_OFFSET_SAMPLE_TEMPERATURES + sensors * 2) },
+    };
+    if (channels > 1) spans.push_back({ FAN_FC_READ_HOLDING, (uint16_t)(base + MODBUS_OFFSET_CHANNEL_FAN_SPEED), channels });
+    return spans;
+}
+
+static bool isMapped(const std::vector<RegisterSpan> &mapped, uint8_t function, uint16_t from, uint16_t to)
+{
+    for (uint16_t address = from; address < to; address++) {
+        bool found = false;
+        for (const RegisterSpan &span : mapped) {
+            if (span.function == function && address >= span.start && address < span.start + span.count) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) return false;
+    }
+    return true;
+}
+
+std::vector<RegisterSpan> mergeReads(std::vector<RegisterSpan> wanted, const std::vector<RegisterSpan> &mapped, uint16_t maxGap, uint16_t maxRead)
+{
+    std::sort(wanted.begin(), wanted.end(), [](const RegisterSpan &a, const RegisterSpan &b) {
+        return a.function != b.function ? a.function < b.function : a.start < b.start;
+    });
+    std::vector<RegisterSpan> reads;
+    for (const RegisterSpan &span : wanted) {
+        if (!reads.empty()) {
+            RegisterSpan &last = reads.back();
+            uint16_t end = last.start + last.count;
+            uint16_t newEnd = std::max<uint16_t>(end, span.start + span.count);
+            // the firmware answers a read only when every register in it is
+            // mapped, so gaps must be mapped too
+            if (last.function == span.function && span.start <= end + maxGap
+                && newEnd - last.start <= maxRead
+                && (span.start <= end || isMapped(mapped, span.function, end, span.start))) {
+                last.count = newEnd - last.start;
+                continue;
+            }
+        }
+        reads.push_back(span);
+    }
+    return reads;
+}
+
+// --- Modbus RTU frames ------------------------------------------------------
+
+uint16_t modbusCrc(const uint8_t *data, size_t length)
+{
+    uint16_t crc = 0xffff;
+    while (length--) {
+        crc ^= *data++;
+        for (uint8_t i = 0; i < 8; i++) {
+            crc = crc & 1 ? (crc >> 1) ^ 0xa001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+static std::vector<uint8_t> request(uint8_t address, uint8_t function, uint16_t first, uint16_t second)
+{
+    std::vector<uint8_t> frame = {
+        address, function,
+        (uint8_t)(first >> 8), (uint8_t)first,
+        (uint8_t)(second >> 8), (uint8_t)second,
+    };
+    uint16_t crc = modbusCrc(frame.data(), frame.size());
+    frame.push_back(crc);
+    frame.push_back(crc >> 8);
+    return frame;
+}
+
+std::vector<uint8_t> readRequest(uint8_t address, const RegisterSpan &span)
+{
+    return request(address, span.function, span.start, span.count);
+}
+
+std::vector<uint8_t> writeRequest(uint8_t address, uint16_t reg, uint16_t value)
+{
+    return request(address, FAN_FC_WRITE_SINGLE, reg, value);
+}
+
+// --- fleet ------------------------------------------------------------------
+
+void LatencyStats::add(uint32_t us)
+{
+    frames++;
+    totalUs += us;
+    minUs = std::min(minUs, us);
+    maxUs = std::max(maxUs, us);
+}
+
+static uint64_t nowUs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+struct FleetPoller::Port
+{
+    int fd = -1;
+    uint32_t charUs = 0;
+    uint32_t gapUs = 0;             // 3.5 characters of silence between frames
+    size_t roundRobin = 0;
+
+    // the device being polled and what is left to read from it
+    bool busy = false;
+    size_t device = 0;
+    std::vector<RegisterSpan> steps;
+    size_t step = 0;
+    bool probe = false;             // the current plan is the change counter alone
+    bool moved = false;             // the change counter moved during this poll
+    uint64_t dueUs = 0;             // when this poll was due
+
+    // the request in flight
+    bool waiting = false;
+    uint64_t sentUs = 0;
+    uint64_t deadlineUs = 0;
+    uint64_t nextSendUs = 0;
+    std::vector<uint8_t> rx;
+
+    // unanswered frames sent before the next request
+    std::vector<std::vector<uint8_t>> broadcasts;
+};
+
+FleetPoller::FleetPoller()
+{
+}
+
+FleetPoller::FleetPoller(const Options &options) : options(options)
+{
+}
+
+FleetPoller::~FleetPoller()
+{
+    for (Port *port : ports) {
+        if (port->fd >= 0) close(port->fd);
+        delete port;
+    }
+}
+
+static speed_t baudConstant(unsigned baud)
+{
+    switch (baud) {
+    case 1200: return B1200;
+    case 2400: return B2400;
+    case 4800: return B4800;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    }
+    return B9600;
+}
+
+bool FleetPoller::addPort(const std::string &path, unsigned baud)
+{
+    int fd = open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) return false;
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetspeed(&tio, baudConstant(baud));
+        tio.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    tcflush(fd, TCIOFLUSH);
+    Port *port = new Port;
+    port->fd = fd;
+    port->charUs = 11000000UL / baud;
+    port->gapUs = baud > 19200 ? 1750 : port->charUs * 7 / 2;
+    ports.push_back(port);
+    return true;
+}
+
+size_t FleetPoller::addDevice(size_t port, uint8_t address, const FanLayout &layout)
+{
+    FanDevice device;
+    device.address = address;
+    device.port = port;
+    device.layout = layout;
+    device.intervalMs = options.minIntervalMs;
+    device.temperatures.assign(layout.sensors, 0);
+    device.sample.assign(layout.sensors, 0);
+    fleet.push_back(device);
+    return fleet.size() - 1;
+}
+
+// what to read next from a device: the change counter alone while it is
+// quiet, everything it publishes once it moved
+void FleetPoller::plan(Port &port, FanDevice &device)
+{
+    const FanLayout &layout = device.layout;
+    std::vector<RegisterSpan> wanted;
+    RegisterSpan sample = { FAN_FC_READ_INPUT, (uint16_t)(layout.base + MODBUS_INPUT_OFFSET_SAMPLE), (uint16_t)(MODBUS_OFFSET_SAMPLE_TEMPERATURES + layout.sensors * 2) };
+    port.probe = !device.changed;
+    wanted.push_back({ FAN_FC_READ_INPUT, (uint16_t)(layout.base + FAN_REG_CHANGE_COUNTER), 1 });
+    // a requested sample is read along with the probe
+    if (device.sampling || !port.probe) wanted.push_back(sample);
+    if (!port.probe) {
+        wanted.push_back({ FAN_FC_READ_INPUT, (uint16_t)(layout.base + MODBUS_INPUT_OFFSET_TEMPERATURES), (uint16_t)(layout.sensors * 2) });
+        wanted.push_back({ FAN_FC_READ_HOLDING, (uint16_t)(layout.base + MODBUS_OFFSET_DEV_ADDR), MODBUS_OFFSET_CHANNEL_FAN_SPEED });
+        if (layout.channels > 1) {
+            wanted.push_back({ FAN_FC_READ_HOLDING, (uint16_t)(layout.base + MODBUS_OFFSET_CHANNEL_FAN_SPEED), layout.channels });
+        }
+    }
+    port.steps = mergeReads(wanted, layout.mapped(), options.maxGap, layout.maxRead);
+    port.step = 0;
+}
+
+bool FleetPoller::startNext(Port &port, uint64_t now)
+{
+    // the most overdue device of this port, round robin among equals
+    size_t best = fleet.size();
+    for (size_t n = 0; n < fleet.size(); n++) {
+        size_t i = (port.roundRobin + n) % fleet.size();
+        FanDevice &device = fleet[i];
+        if (ports[device.port] != &port || device.dueUs > now) continue;
+        if (best == fleet.size() || device.dueUs < fleet[best].dueUs) best = i;
+    }
+    if (best == fleet.size()) return false;
+    port.roundRobin = best + 1;
+    port.busy = true;
+    port.device = best;
+    port.moved = false;
+    port.dueUs = fleet[best].dueUs;
+    fleet[best].polls++;
+    plan(port, fleet[best]);
+    return true;
+}
+
+void FleetPoller::send(Port &port, uint64_t now)
+{
+    FanDevice &device = fleet[port.device];
+    std::vector<uint8_t> frame = readRequest(device.address, port.steps[port.step]);
+    port.rx.clear();
+    tcflush(port.fd, TCIFLUSH);
+    if (write(port.fd, frame.data(), frame.size()) != (ssize_t)frame.size()) {
+        fail(port, now, false);
+        return;
+    }
+    port.waiting = true;
+    port.sentUs = now;
+    port.deadlineUs = now + options.timeoutMs * 1000ULL;
+}
+
+static float registerFloat(const std::vector<uint16_t> &words, size_t index)
+{
+    uint32_t bits = (uint32_t)words[index] << 16 | words[index + 1];
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void FleetPoller::complete(Port &port, uint64_t now, void (*update)(const FanDevice &))
+{
+    FanDevice &device = fleet[port.device];
+    const RegisterSpan &span = port.steps[port.step];
+    port.waiting = false;
+    device.latency.add(now - port.sentUs);
+
+    const std::vector<uint8_t> &rx = port.rx;
+    // address, function, byte count, the registers asked for and CRC
+    if (rx.size() != 5u + span.count * 2 || rx[0] != device.address || rx[1] != span.function
+        || rx[2] != span.count * 2 || modbusCrc(rx.data(), rx.size()) != 0) {
+        fail(port, now, false);
+        return;
+    }
+    device.online = true;
+
+    std::vector<uint16_t> words(span.count);
+    for (uint16_t i = 0; i < span.count; i++) {
+        words[i] = rx[3 + i * 2] << 8 | rx[4 + i * 2];
+    }
+    uint16_t base = device.layout.base;
+    for (uint16_t i = 0; i < span.count; i++) {
+        uint16_t address = span.start + i - base;
+        if (span.function == FAN_FC_READ_HOLDING) {
+            if (device.holding.size() <= address) device.holding.resize(address + 1);
+            device.holding[address] = words[i];
+        } else if (address == FAN_REG_CHANGE_COUNTER) {
+            uint16_t counter = words[i];
+            if (counter != device.changeCounter || (!port.probe && !device.fullReads)) port.moved = true;
+            device.changeCounter = counter;
+        } else if (address < device.layout.sensors * 2 && !(address & 1) && i + 1 < span.count) {
+            device.temperatures[address / 2] = registerFloat(words, i);
+        } else if (address == MODBUS_INPUT_OFFSET_SAMPLE + MODBUS_OFFSET_SAMPLE_SEQUENCE) {
+            device.sampleSequence = words[i];
+            if (device.sampleSequence == sampleRequested) device.sampling = false;
+        } else if (address == MODBUS_INPUT_OFFSET_SAMPLE + MODBUS_OFFSET_SAMPLE_DELAY) {
+            device.sampleDelayUs = words[i];
+        } else if (address >= FAN_REG_SAMPLE_TEMPERATURES && address < FAN_REG_SAMPLE_TEMPERATURES + device.layout.sensors * 2
+                   && !(address & 1) && i + 1 < span.count) {
+            device.sample[(address - FAN_REG_SAMPLE_TEMPERATURES) / 2] = registerFloat(words, i);
+        }
+    }
+
+    if (++port.step < port.steps.size()) return;
+    device.changed = port.moved;
+    if (port.probe && port.moved) {
+        // moved since the last poll: read everything right away
+        plan(port, device);
+        return;
+    }
+    if (!port.probe) {
+        device.fullReads++;
+        if (update && port.moved) update(device);
+    }
+    finish(port, now);
+}
+
+void FleetPoller::fail(Port &port, uint64_t now, bool timeout)
+{
+    FanDevice &device = fleet[port.device];
+    if (timeout) {
+        device.latency.timeouts++;
+    } else {
+        device.latency.errors++;
+    }
+    port.waiting = false;
+    // read everything again once it answers
+    device.online = false;
+    device.changed = true;
+    finish(port, now);
+}
+
+void FleetPoller::finish(Port &port, uint64_t now)
+{
+    FanDevice &device = fleet[port.device];
+    if (device.polls > 1 && now > port.dueUs + device.intervalMs * 1000ULL) device.missed++;
+    if (device.changed && device.online) {
+        device.intervalMs = options.minIntervalMs;
+    } else {
+        device.intervalMs = std::min(options.maxIntervalMs, std::max(options.minIntervalMs, device.intervalMs * 2));
+    }
+    // on the poll's own schedule, without catching up on missed ones
+    device.dueUs = std::max<uint64_t>(now, port.dueUs + device.intervalMs * 1000ULL);
+    // a requested sample not latched yet is asked for again shortly
+    if (device.sampling && device.online) device.dueUs = std::min<uint64_t>(device.dueUs, now + FAN_SAMPLE_RETRY_MS * 1000ULL);
+    port.busy = false;
+}
+
+void FleetPoller::sample(uint16_t sequence)
+{
+    sampleRequested = sequence;
+    for (FanDevice &device : fleet) {
+        // one broadcast per register base in use on the port
+        std::vector<uint8_t> frame = writeRequest(0, device.layout.base + MODBUS_OFFSET_SAMPLE_NOW, sequence);
+        std::vector<std::vector<uint8_t>> &broadcasts = ports[device.port]->broadcasts;
+        if (std::find(broadcasts.begin(), broadcasts.end(), frame) == broadcasts.end()) broadcasts.push_back(frame);
+    }
+}
+
+// expected length of the response collected so far, 0 while unknown
+static size_t responseLength(const std::vector<uint8_t> &rx)
+{
+    if (rx.size() < 3) return 0;
+    if (rx[1] & 0x80) return 5;
+    return 5 + rx[2];
+}
+
+void FleetPoller::run(uint32_t durationMs, void (*update)(const FanDevice &device))
+{
+    uint64_t end = nowUs() + durationMs * 1000ULL;
+    std::vector<struct pollfd> fds(ports.size());
+
+    for (;;) {
+        uint64_t now = nowUs();
+        if (now >= end) break;
+
+        // keep every port busy: the next frame goes out as soon as the bus
+        // has been quiet for 3.5 characters
+        uint64_t wake = end;
+        for (Port *port : ports) {
+            if (port->waiting) {
+                if (now >= port->deadlineUs) {
+                    fail(*port, now, true);
+                    port->nextSendUs = now + port->gapUs;
+                } else {
+                    wake = std::min(wake, port->deadlineUs);
+                    continue;
+                }
+            }
+            if (!port->broadcasts.empty()) {
+                if (now >= port->nextSendUs) {
+                    const std::vector<uint8_t> &frame = port->broadcasts.front();
+                    (void)!write(port->fd, frame.data(), frame.size());
+                    port->nextSendUs = now + frame.size() * port->charUs + port->gapUs;
+                    port->broadcasts.erase(port->broadcasts.begin());
+                    // read the sample as soon as it is converted
+                    for (FanDevice &device : fleet) {
+                        if (ports[device.port] != port) continue;
+                        device.dueUs = std::min<uint64_t>(device.dueUs, port->nextSendUs + FAN_SAMPLE_READ_MS * 1000ULL);
+                        device.intervalMs = options.minIntervalMs;
+                        device.sampling = true;
+                    }
+                }
+                wake = std::min(wake, port->nextSendUs);
+                continue;
+            }
+            if (!port->busy && !startNext(*port, now)) {
+                for (const FanDevice &device : fleet) {
+                    if (ports[device.port] == port) wake = std::min(wake, device.dueUs);
+                }
+                continue;
+            }
+            if (now < port->nextSendUs) {
+                wake = std::min(wake, port->nextSendUs);
+                continue;
+            }
+            send(*port, now);
+            if (port->waiting) wake = std::min(wake, port->deadlineUs);
+        }
+
+        for (size_t i = 0; i < ports.size(); i++) {
+            fds[i].fd = ports[i]->fd;
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+        }
+        now = nowUs();
+        int timeout = wake > now ? (int)((wake - now + 999) / 1000) : 0;
+        poll(fds.data(), fds.size(), timeout);
+
+        now = nowUs();
+        for (size_t i = 0; i < ports.size(); i++) {
+            Port &port = *ports[i];
+            if (!(fds[i].revents & POLLIN)) continue;
+            uint8_t buffer[256];
+            ssize_t n = read(port.fd, buffer, sizeof(buffer));
+            if (n <= 0 || !port.waiting) continue;
+            port.rx.insert(port.rx.end(), buffer, buffer + n);
+            size_t length = responseLength(port.rx);
+            if (!length || port.rx.size() < length) continue;
+            port.rx.resize(length);
+            complete(port, now, update);
+            port.nextSendUs = now + port.gapUs;
+        }
+    }
+}
@@ -0,0 +1,146 @@
+#pragma once
+// Modbus RTU master for a fleet of fan controllers on one or more serial
+// ports (Linux). Knows the firmware's register map (README.md), polls each
+// controller's change counter and only reads the full status after it moved,
+// adapts every controller's poll interval to how often it changes, merges
+// adjacent register reads into single frames and keeps one request in flight
+// per port, with all ports served in parallel from one poll() loop.
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "../../src/FanRegisters.h"
+
+// --- register map -----------------------------------------------------------
+
+#define FAN_FC_READ_HOLDING 0x03
+#define FAN_FC_READ_INPUT 0x04
+#define FAN_FC_WRITE_SINGLE 0x06
+
+// the register offsets and frame size come from the firmware
+#define FAN_REG_CHANGE_COUNTER (MODBUS_INPUT_OFFSET_DIAG + MODBUS_OFFSET_DIAG_CHANGE_COUNTER)
+#define FAN_REG_SAMPLE_TEMPERATURES (MODBUS_INPUT_OFFSET_SAMPLE + MODBUS_OFFSET_SAMPLE_TEMPERATURES)
+
+// registers per read: a frame holds them after address, function, byte
+// count and CRC
+#define FAN_MAX_READ ((MODBUS_MAX_FRAME - 5) / 2)
+
+// a requested sample is read back after the conversion and its alignment
+#define FAN_SAMPLE_READ_MS 800
+#define FAN_SAMPLE_RETRY_MS 50
+
+struct RegisterSpan
+{
+    uint8_t function;
+    uint16_t start;
+    uint16_t count;
+};
+
+// what a board variant maps, see src/Boards.h
+struct FanLayout
+{
+    uint8_t sensors = 2;
+    uint8_t tasks = 3;          // 4 on display boards
+    uint8_t channels = 1;
+    uint16_t base = 0;
+    uint16_t maxRead = FAN_MAX_READ;
+
+    // every mapped register, as spans per function
+    std::vector<RegisterSpan> mapped() const;
+};
+
+// Join spans of the same function into as few reads as possible: two spans
+// merge when the registers between them are mapped and at most maxGap long,
+// and the result stays within maxRead registers.
+std::vector<RegisterSpan> mergeReads(std::vector<RegisterSpan> wanted, const std::vector<RegisterSpan> &mapped, uint16_t maxGap, uint16_t maxRead = FAN_MAX_READ);
+
+// --- Modbus RTU frames ------------------------------------------------------
+
+uint16_t modbusCrc(const uint8_t *data, size_t length);
+std::vector<uint8_t> readRequest(uint8_t address, const RegisterSpan &span);
+std::vector<uint8_t> writeRequest(uint8_t address, uint16_t reg, uint16_t value);
+
+// --- fleet ------------------------------------------------------------------
+
+struct LatencyStats
+{
+    uint32_t frames = 0;
+    uint32_t timeouts = 0;
+    uint32_t errors = 0;        // bad crc, wrong length or exception
+    uint32_t minUs = UINT32_MAX;
+    uint32_t maxUs = 0;
+    uint64_t totalUs = 0;
+
+    void add(uint32_t us);
+    uint32_t meanUs() const { return frames ? totalUs / frames : 0; }
+};
+
+struct FanDevice
+{
+    uint8_t address;
+    size_t port;
+    FanLayout layout;
+
+    // last values read
+    bool online = false;
+    bool changed = true;        // counter moved at the last poll, or never read
+    uint16_t changeCounter = 0;
+    std::vector<float> temperatures;
+    std::vector<uint16_t> holding;  // MODBUS_OFFSET_DEV_ADDR.. as read
+    bool sampling = false;          // the requested sample is not read yet
+    uint16_t sampleSequence = 0;    // of the last sample latched
+    uint16_t sampleDelayUs = 0;     // from the broadcast to its conversion
+    std::vector<float> sample;
+
+    // scheduling
+    uint32_t intervalMs = 0;
+    uint64_t dueUs = 0;
+    uint32_t polls = 0;
+    uint32_t fullReads = 0;
+    uint32_t missed = 0;        // polls that ended after the next one was due
+    LatencyStats latency;
+};
+
+class FleetPoller
+{
+public:
+    struct Options
+    {
+        uint32_t minIntervalMs = 100;   // while a controller keeps changing
+        uint32_t maxIntervalMs = 5000;  // backed off to, doubling, while it does not
+        uint32_t timeoutMs = 100;       // response timeout, after the request left
+        uint16_t maxGap = 8;            // unwanted registers read to save a frame
+    };
+
+    FleetPoller();
+    explicit FleetPoller(const Options &options);
+    ~FleetPoller();
+
+    // open a serial port or pty; false on error
+    bool addPort(const std::string &path, unsigned baud = 9600);
+    size_t addDevice(size_t port, uint8_t address, const FanLayout &layout = FanLayout());
+
+    // broadcast "sample now" with sequence on every port, ahead of the next
+    // request, and read the sample back from every device once converted
+    void sample(uint16_t sequence);
+
+    // poll for durationMs, calling update with each device whose values changed
+    void run(uint32_t durationMs, void (*update)(const FanDevice &device) = 0);
+
+    const std::vector<FanDevice> &devices() const { return fleet; }
+
+private:
+    struct Port;
+
+    Options options;
+    std::vector<Port *> ports;
+    std::vector<FanDevice> fleet;
+    uint16_t sampleRequested = 0;
+
+    void plan(Port &port, FanDevice &device);
+    bool startNext(Port &port, uint64_t now);
+    void send(Port &port, uint64_t now);
+    void complete(Port &port, uint64_t now, void (*update)(const FanDevice &));
+    void fail(Port &port, uint64_t now, bool timeout);
+    void finish(Port &port, uint64_t now);
+};
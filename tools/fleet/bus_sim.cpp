@@ -0,0 +1,354 @@
+// Simulated RS485 segment: N native firmware instances (README.md, Native
+// build), each with its own EEPROM image and enclosure, share one half-duplex
+// bus with the fleet poller as master. Characters take their time on the wire
+// at the given baud rate, a station starting to send waits for its driver
+// turnaround, and stations sending at once collide. Each N runs for the given
+// time with every controller polled once per period; the table shows bus
+// utilization, frame latency and polls that missed their period. With -S the
+// whole segment is told to sample every given ms, and the table also shows
+// how many samples were collected from every controller and how far apart
+// their conversions started.
+//
+//   g++ -std=c++17 -O2 -pthread tools/fleet/FleetPoller.cpp tools/fleet/bus_sim.cpp -o bus_sim
+//   ./bus_sim [-b baud] [-s seconds] [-p period ms] [-t turnaround us] [-S sample ms] [-v] ./fan_native 1 2 4 8 16 32
+
+#include "FleetPoller.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t nowUs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+static void makeRaw(int fd)
+{
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+}
+
+// --- bus --------------------------------------------------------------------
+
+struct Station
+{
+    int fd;
+    std::deque<uint8_t> pending;    // written, not on the wire yet
+    uint64_t readyUs = 0;           // driver enabled, may start sending
+    uint64_t lastCharUs = 0;        // end of its last character on the wire
+};
+
+class Bus
+{
+    std::vector<Station> stations;  // 0 is the master
+    uint32_t charUs;
+    uint32_t turnaroundUs;
+
+    bool onWire = false;
+    uint8_t wireByte = 0;
+    uint64_t wireEndUs = 0;
+    std::vector<size_t> senders;
+
+public:
+    uint64_t busyUs = 0;
+    uint32_t characters = 0;
+    uint32_t collisions = 0;
+
+    Bus(unsigned baud, uint32_t turnaroundUs)
+        : charUs(10000000UL / baud), turnaroundUs(turnaroundUs) // 8N1
+    {
+    }
+
+    void attach(int fd)
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        Station station;
+        station.fd = fd;
+        stations.push_back(station);
+    }
+
+    void run(const std::atomic<bool> &stop)
+    {
+        std::vector<struct pollfd> fds(stations.size());
+        while (!stop) {
+            uint64_t now = nowUs();
+
+            // a character reaches every station but its senders
+            if (onWire && now >= wireEndUs) {
+                for (size_t i = 0; i < stations.size(); i++) {
+                    if (std::find(senders.begin(), senders.end(), i) == senders.end()) {
+                        (void)!write(stations[i].fd, &wireByte, 1);
+                    }
+                }
+                onWire = false;
+            }
+
+            // the next character: whoever is ready drives the bus, several
+            // drivers at once leave the dominant (low) bits
+            if (!onWire) {
+                senders.clear();
+                wireByte = 0xff;
+                for (size_t i = 0; i < stations.size(); i++) {
+                    Station &station = stations[i];
+                    if (station.pending.empty() || station.readyUs > now) continue;
+                    wireByte &= station.pending.front();
+                    station.pending.pop_front();
+                    senders.push_back(i);
+                }
+                if (!senders.empty()) {
+                    if (senders.size() > 1) collisions++;
+                    onWire = true;
+                    wireEndUs = now + charUs;
+                    busyUs += charUs;
+                    characters++;
+                    for (size_t i : senders) stations[i].lastCharUs = wireEndUs;
+                }
+            }
+
+            uint64_t wake = now + 10000;
+            if (onWire) wake = wireEndUs;
+            for (const Station &station : stations) {
+                if (!station.pending.empty()) wake = std::min(wake, std::max(station.readyUs, now));
+            }
+            for (size_t i = 0; i < stations.size(); i++) {
+                fds[i] = { stations[i].fd, POLLIN, 0 };
+            }
+            uint64_t wait = wake > now ? wake - now : 0;
+            struct timespec timeout = { (time_t)(wait / 1000000), (long)(wait % 1000000) * 1000 };
+            if (ppoll(fds.data(), fds.size(), &timeout, 0) <= 0) continue;
+
+            now = nowUs();
+            for (size_t i = 0; i < stations.size(); i++) {
+                if (!(fds[i].revents & POLLIN)) continue;
+                Station &station = stations[i];
+                uint8_t buffer[256];
+                ssize_t n = read(station.fd, buffer, sizeof(buffer));
+                if (n <= 0) continue;
+                // a new transmission waits for the driver, a running one goes on
+                if (station.pending.empty() && now > station.lastCharUs + charUs) station.readyUs = now + turnaroundUs;
+                station.pending.insert(station.pending.end(), buffer, buffer + n);
+            }
+        }
+    }
+};
+
+// --- firmware instances -----------------------------------------------------
+
+struct Instance
+{
+    pid_t pid;
+    int fd;
+};
+
+static bool spawn(const char *firmware, const char *dir, unsigned n, Instance &instance)
+{
+    int out[2];
+    if (pipe(out)) return false;
+    pid_t pid = fork();
+    if (pid == 0) {
+        char value[256];
+        snprintf(value, sizeof(value), "%s/eeprom-%u", dir, n);
+        setenv("FAN_EEPROM", value, 1);
+        snprintf(value, sizeof(value), "%u", n + 1);
+        setenv("FAN_ADDRESS", value, 1);
+        // different loads, so the controllers change at different rates
+        snprintf(value, sizeof(value), "%u", 60 + (n * 37) % 140);
+        setenv("FAN_LOAD", value, 1);
+        unsetenv("FAN_PTY_FD");
+        unsetenv("FAN_TEMPS");
+        dup2(out[1], 1);
+        close(out[0]);
+        close(out[1]);
+        execl(firmware, firmware, (char *)0);
+        _exit(127);
+    }
+    close(out[1]);
+    if (pid < 0) {
+        close(out[0]);
+        return false;
+    }
+
+    // "pty <path>" names the instance's end of the bus
+    char line[256];
+    FILE *stream = fdopen(out[0], "r");
+    bool named = fgets(line, sizeof(line), stream) && strncmp(line, "pty ", 4) == 0;
+    fclose(stream);
+    if (!named) {
+        kill(pid, SIGTERM);
+        waitpid(pid, 0, 0);
+        return false;
+    }
+    line[strcspn(line, "\n")] = 0;
+    instance.pid = pid;
+    instance.fd = open(line + 4, O_RDWR | O_NOCTTY);
+    return instance.fd >= 0;
+}
+
+static void stopInstances(std::vector<Instance> &instances)
+{
+    for (Instance &instance : instances) {
+        kill(instance.pid, SIGTERM);
+        waitpid(instance.pid, 0, 0);
+        close(instance.fd);
+    }
+    instances.clear();
+}
+
+// --- main -------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+    unsigned baud = 9600;
+    unsigned seconds = 10;
+    uint32_t periodMs = 1000;
+    uint32_t turnaroundUs = 100;
+    uint32_t sampleMs = 0;
+    bool verbose = false;
+    int option;
+    while ((option = getopt(argc, argv, "b:s:p:t:S:v")) != -1) {
+        switch (option) {
+        case 'b': baud = atoi(optarg); break;
+        case 's': seconds = atoi(optarg); break;
+        case 'p': periodMs = atoi(optarg); break;
+        case 't': turnaroundUs = atoi(optarg); break;
+        case 'S': sampleMs = atoi(optarg); break;
+        case 'v': verbose = true; break;
+        default:
+            optind = argc;
+            break;
+        }
+    }
+    if (optind + 2 > argc) {
+        fprintf(stderr, "usage: %s [-b baud] [-s seconds] [-p period ms] [-t turnaround us] [-S sample ms] [-v] firmware count ...\n", argv[0]);
+        return 2;
+    }
+    const char *firmware = argv[optind++];
+    char dir[] = "/tmp/bus_sim.XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    printf("%u baud, %u us turnaround, every controller polled each %u ms for %u s\n", baud, turnaroundUs, periodMs, seconds);
+    printf("%5s %7s %9s %7s %7s %9s %9s %7s %8s %6s", "N", "bus %", "collide", "polls", "frames",
+           "mean us", "max us", "missed", "timeouts", "errors");
+    if (sampleMs) printf(" %9s %9s", "samples", "spread us");
+    printf("\n");
+    for (; optind < argc; optind++) {
+        unsigned count = atoi(argv[optind]);
+        std::vector<Instance> instances;
+        Bus bus(baud, turnaroundUs);
+
+        // the master's end of the bus is a pty of its own
+        int master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master < 0 || grantpt(master) || unlockpt(master)) {
+            perror("pty");
+            return 1;
+        }
+        std::string masterPath = ptsname(master);
+        int keep = open(masterPath.c_str(), O_RDWR | O_NOCTTY);
+        makeRaw(keep);
+        bus.attach(master);
+
+        for (unsigned n = 0; n < count; n++) {
+            Instance instance;
+            if (!spawn(firmware, dir, n, instance)) {
+                fprintf(stderr, "%s: instance %u did not start\n", firmware, n);
+                stopInstances(instances);
+                return 1;
+            }
+            instances.push_back(instance);
+            bus.attach(instance.fd);
+        }
+
+        FleetPoller::Options options;
+        options.minIntervalMs = periodMs;
+        options.maxIntervalMs = periodMs;
+        FleetPoller poller(options);
+        poller.addPort(masterPath, baud);
+        for (unsigned n = 0; n < count; n++) {
+            poller.addDevice(0, n + 1);
+        }
+
+        std::atomic<bool> stop(false);
+        std::thread wire([&] { bus.run(stop); });
+        uint64_t start = nowUs();
+        unsigned samples = 0, complete = 0;
+        uint32_t spreadUs = 0;
+        if (sampleMs) {
+            // the delays are measured from the same broadcast frame, so
+            // their spread is how far apart the conversions started
+            for (uint32_t ms = 0; ms < seconds * 1000; ms += sampleMs) {
+                poller.sample(++samples);
+                poller.run(sampleMs);
+                uint16_t first = UINT16_MAX, last = 0;
+                bool all = true;
+                for (const FanDevice &device : poller.devices()) {
+                    all = all && device.sampleSequence == samples;
+                    first = std::min(first, device.sampleDelayUs);
+                    last = std::max(last, device.sampleDelayUs);
+                }
+                if (!all) continue;
+                complete++;
+                spreadUs = std::max<uint32_t>(spreadUs, last - first);
+            }
+        } else {
+            poller.run(seconds * 1000);
+        }
+        uint64_t elapsed = nowUs() - start;
+        stop = true;
+        wire.join();
+
+        uint32_t polls = 0, frames = 0, missed = 0, timeouts = 0, errors = 0, maxUs = 0;
+        uint64_t totalUs = 0;
+        for (const FanDevice &device : poller.devices()) {
+            polls += device.polls;
+            frames += device.latency.frames;
+            totalUs += device.latency.totalUs;
+            maxUs = std::max(maxUs, device.latency.maxUs);
+            missed += device.missed;
+            timeouts += device.latency.timeouts;
+            errors += device.latency.errors;
+        }
+        printf("%5u %7.1f %9u %7u %7u %9u %9u %7u %8u %6u", count, 100.0 * bus.busyUs / elapsed, bus.collisions,
+               polls, frames, frames ? (uint32_t)(totalUs / frames) : 0, maxUs, missed, timeouts, errors);
+        if (sampleMs) printf(" %4u/%-4u %9u", complete, samples, spreadUs);
+        printf("\n");
+        if (verbose) {
+            for (const FanDevice &device : poller.devices()) {
+                printf("      address %3u: %u polls, %u full, mean %u us, max %u us, %u missed, %u timeouts, %u errors\n",
+                       device.address, device.polls, device.fullReads, device.latency.meanUs(), device.latency.maxUs,
+                       device.missed, device.latency.timeouts, device.latency.errors);
+            }
+        }
+        fflush(stdout);
+
+        stopInstances(instances);
+        close(keep);
+        close(master);
+    }
+
+    for (unsigned n = 0; ; n++) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/eeprom-%u", dir, n);
+        if (unlink(path)) break;
+    }
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,56 @@
+#!/bin/sh
+# Poll two native controllers with fixed temperatures through fleet_poll and
+# check the values it decodes: temperatures, fan speed, error, a broadcast
+# sample and a clean link. Run from the repository root:
+#
+#   tools/fleet/fleet_check.sh
+#
+# Exits 1 on the first mismatch.
+
+set -e
+dir=$(mktemp -d)
+pids=
+cleanup() {
+    [ -n "$pids" ] && kill $pids 2>/dev/null
+    rm -rf "$dir"
+}
+trap cleanup EXIT
+
+g++ -std=gnu++17 -O2 -Itools/native -Ilib/FanControl -Ilib/ModbusRtu -Ilib/Scheduler -Ilib/SDA5708 -Ilib/MemoryStats -Ilib/ResetRecord -Ilib/OneWireBank -Isrc src/main.cpp tools/native/native.cpp -o "$dir/fan_native"
+g++ -std=c++17 -O2 tools/fleet/FleetPoller.cpp tools/fleet/fleet_poll.cpp -o "$dir/fleet_poll"
+
+# address, temperatures: one hot controller above the 30 C threshold, one cool
+start() {
+    FAN_EEPROM="$dir/eeprom$1" FAN_ADDRESS=$1 FAN_TEMPS=$2 "$dir/fan_native" > "$dir/pty$1" &
+    pids="$pids $!"
+}
+start 7 33.50,24.25
+start 9 21.00,22.75
+sleep 1
+pty7=$(awk '{print $2}' "$dir/pty7")
+pty9=$(awk '{print $2}' "$dir/pty9")
+
+"$dir/fleet_poll" -s 4 -S 1500 "$pty7:7" "$pty9:9" > "$dir/out"
+
+fail() {
+    echo "fleet_check: $1" >&2
+    cat "$dir/out" >&2
+    exit 1
+}
+
+# the last update of each controller: fan speed, error and temperatures
+expect() {
+    line=$(grep "port $1 address *$2 counter" "$dir/out" | tail -1)
+    echo "$line" | grep -q "fan *$3 error 0 *$4 *$5\$" || fail "address $2: got '$line'"
+}
+expect 0 7 100 33.50 24.25
+expect 1 9 0 21.00 22.75
+
+# every sample after the first one collected, with the same temperatures
+grep -q "address *7 delay *[0-9]* us *33.50 *24.25" "$dir/out" || fail "no sample from address 7"
+grep -q "address *9 delay *[0-9]* us *21.00 *22.75" "$dir/out" || fail "no sample from address 9"
+
+# no timeouts and no bad frames
+awk '$1 ~ /^[0-9]+$/ && NF == 10 && ($6 != 0 || $7 != 0) { bad = 1 } END { exit bad }' "$dir/out" || fail "timeouts or errors"
+
+echo "fleet_check: ok"
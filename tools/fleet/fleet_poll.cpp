@@ -0,0 +1,112 @@
+// Poll a fleet of fan controllers and print what changed, then a summary of
+// polls, full reads and frame latency per controller. With -S every
+// controller is told to sample at the same moment every given ms, and each
+// sample is printed as one snapshot of the fleet.
+//
+//   g++ -std=c++17 -O2 tools/fleet/FleetPoller.cpp tools/fleet/fleet_poll.cpp -o fleet_poll
+//   ./fleet_poll [-b baud] [-s seconds] [-S sample ms] [-q] port:address[,address...] ...
+//
+// e.g. ./fleet_poll -s 30 /dev/ttyUSB0:1,2,3 /dev/ttyUSB1:1,2
+
+#include "FleetPoller.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static bool quiet;
+
+static void update(const FanDevice &device)
+{
+    if (quiet) return;
+    printf("port %zu address %3u counter %5u fan %3u error %u  ", device.port, device.address,
+           device.changeCounter, device.holding.size() > MODBUS_OFFSET_FAN_SPEED ? device.holding[MODBUS_OFFSET_FAN_SPEED] : 0,
+           device.holding.size() > MODBUS_OFFSET_ERROR ? device.holding[MODBUS_OFFSET_ERROR] : 0);
+    for (float temperature : device.temperatures) {
+        printf(" %6.2f", temperature);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+static void printSample(const FleetPoller &poller, uint16_t sequence)
+{
+    printf("sample %u\n", sequence);
+    for (const FanDevice &device : poller.devices()) {
+        printf("  port %zu address %3u ", device.port, device.address);
+        if (device.sampleSequence != sequence) {
+            printf("not collected\n");
+            continue;
+        }
+        printf("delay %5u us ", device.sampleDelayUs);
+        for (float temperature : device.sample) {
+            printf(" %6.2f", temperature);
+        }
+        printf("\n");
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned baud = 9600;
+    unsigned seconds = 10;
+    unsigned sampleMs = 0;
+    int option;
+    while ((option = getopt(argc, argv, "b:s:S:q")) != -1) {
+        switch (option) {
+        case 'b': baud = atoi(optarg); break;
+        case 's': seconds = atoi(optarg); break;
+        case 'S': sampleMs = std::max(atoi(optarg), FAN_SAMPLE_READ_MS + 200); break;
+        case 'q': quiet = true; break;
+        default:
+            fprintf(stderr, "usage: %s [-b baud] [-s seconds] [-S sample ms] [-q] port:address[,address...] ...\n", argv[0]);
+            return 2;
+        }
+    }
+
+    FleetPoller poller;
+    for (size_t port = 0; optind < argc; optind++, port++) {
+        char *spec = argv[optind];
+        char *addresses = strrchr(spec, ':');
+        if (!addresses) {
+            fprintf(stderr, "%s: no addresses\n", spec);
+            return 2;
+        }
+        *addresses++ = 0;
+        if (!poller.addPort(spec, baud)) {
+            perror(spec);
+            return 1;
+        }
+        for (char *address = strtok(addresses, ","); address; address = strtok(0, ",")) {
+            poller.addDevice(port, atoi(address));
+        }
+    }
+    if (poller.devices().empty()) {
+        fprintf(stderr, "no devices\n");
+        return 2;
+    }
+
+    if (sampleMs) {
+        uint16_t sequence = 0;
+        for (unsigned elapsed = 0; elapsed < seconds * 1000; elapsed += sampleMs) {
+            if (++sequence == 0) sequence = 1;
+            poller.sample(sequence);
+            poller.run(sampleMs, update);
+            printSample(poller, sequence);
+        }
+    } else {
+        poller.run(seconds * 1000, update);
+    }
+
+    printf("%-5s %-8s %7s %7s %7s %8s %6s %9s %9s %9s\n", "port", "address", "polls", "full", "frames",
+           "timeouts", "errors", "min us", "mean us", "max us");
+    for (const FanDevice &device : poller.devices()) {
+        const LatencyStats &latency = device.latency;
+        printf("%-5zu %-8u %7u %7u %7u %8u %6u %9u %9u %9u\n", device.port, device.address, device.polls,
+               device.fullReads, latency.frames, latency.timeouts, latency.errors,
+               latency.frames ? latency.minUs : 0, latency.meanUs(), latency.maxUs);
+    }
+    return 0;
+}
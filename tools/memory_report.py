@@ -0,0 +1,164 @@
+"""Per-module RAM and flash report from the linker map and the ELF.
+
+Runs after every PlatformIO link (extra_scripts in platformio.ini), prints the
+report and writes it to memory_report.txt next to firmware.elf so two builds
+can be diffed. The build fails when static RAM leaves less than
+custom_min_free_ram bytes for the stack.
+
+Standalone:
+
+    python3 tools/memory_report.py .pio/build/nanoatmega328/firmware.map \
+        [.pio/build/nanoatmega328/firmware.elf] [--nm avr-nm] [--ram 2048]
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+from collections import defaultdict
+
+RAM_SIZE = 2048
+TOP_SYMBOLS = 15
+
+# input section -> which memories it takes
+SECTIONS = {
+    ".text": ("flash",),
+    ".data": ("flash", "ram"),
+    ".bss": ("ram",),
+    ".noinit": ("ram",),
+}
+
+OUTPUT_SECTION = re.compile(r"^(\.\w+)\s")
+INPUT_SECTION = re.compile(r"^ (\.[\w.]+|COMMON)?\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$")
+
+
+def module_name(obj):
+    """Short module name of an object file path from the map."""
+    archive = re.match(r"(.*)\((.*)\)$", obj)
+    if archive:
+        lib = os.path.basename(archive.group(1))
+        lib = re.sub(r"^lib|\.a$", "", lib)
+        if lib in ("FrameworkArduino", "c", "m", "gcc"):
+            return lib
+        return "lib/" + lib
+    obj = "/" + obj.replace("\\", "/")
+    if "/src/" in obj:
+        return "src/" + re.sub(r"\.o$", "", obj.split("/src/", 1)[1])
+    return os.path.basename(obj)
+
+
+def parse_map(path):
+    """Bytes of flash and RAM per module from the linker map."""
+    usage = defaultdict(lambda: {"flash": 0, "ram": 0})
+    output = None
+    pending = None
+    in_memory_map = False
+    with open(path) as f:
+        for line in f:
+            line = line.rstrip("\n")
+            if line.startswith("Linker script and memory map"):
+                in_memory_map = True
+                continue
+            if not in_memory_map:
+                continue
+            match = OUTPUT_SECTION.match(line)
+            if match:
+                output = match.group(1)
+                pending = None
+                continue
+            # long input section names put the address on the next line
+            if re.match(r"^ \.[\w.]+$", line):
+                pending = line.strip()
+                continue
+            match = INPUT_SECTION.match(line)
+            if not match or output not in SECTIONS:
+                pending = None
+                continue
+            if not match.group(1) and not pending:
+                continue
+            size = int(match.group(3), 16)
+            obj = match.group(4).strip()
+            pending = None
+            if not size or obj.startswith("0x") or obj.startswith("load address"):
+                continue
+            for memory in SECTIONS[output]:
+                usage[module_name(obj)][memory] += size
+    return usage
+
+
+def top_ram_symbols(elf, nm):
+    """Largest RAM symbols of the ELF, by nm."""
+    try:
+        out = subprocess.run([nm, "-C", "-S", "--size-sort", elf],
+                             capture_output=True, text=True, check=True).stdout
+    except (OSError, subprocess.CalledProcessError):
+        return []
+    symbols = []
+    for line in out.splitlines():
+        parts = line.split(None, 3)
+        if len(parts) == 4 and parts[2] in "bBdD":
+            symbols.append((int(parts[1], 16), parts[3]))
+    return sorted(symbols, reverse=True)[:TOP_SYMBOLS]
+
+
+def report(map_path, elf=None, nm="avr-nm", ram_size=RAM_SIZE):
+    """Report text and the bytes of RAM left for the stack."""
+    usage = parse_map(map_path)
+    lines = ["%-32s %8s %8s" % ("module", "flash", "ram")]
+    for name, sizes in sorted(usage.items(), key=lambda u: (-u[1]["ram"], -u[1]["flash"])):
+        lines.append("%-32s %8d %8d" % (name, sizes["flash"], sizes["ram"]))
+    flash = sum(u["flash"] for u in usage.values())
+    ram = sum(u["ram"] for u in usage.values())
+    free = ram_size - ram
+    lines.append("%-32s %8d %8d" % ("total", flash, ram))
+    lines.append("RAM left for stack and heap: %d of %d bytes" % (free, ram_size))
+    if elf:
+        symbols = top_ram_symbols(elf, nm)
+        if symbols:
+            lines.append("")
+            lines.append("largest RAM symbols:")
+            lines.extend("%8d  %s" % symbol for symbol in symbols)
+    return "\n".join(lines), free
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("map")
+    parser.add_argument("elf", nargs="?")
+    parser.add_argument("--nm", default="avr-nm")
+    parser.add_argument("--ram", type=int, default=RAM_SIZE)
+    parser.add_argument("--min-free", type=int, default=0)
+    args = parser.parse_args()
+    text, free = report(args.map, args.elf, args.nm, args.ram)
+    print(text)
+    return 1 if free < args.min_free else 0
+
+
+def pio_post_link(env):
+    map_path = env.subst("$BUILD_DIR/${PROGNAME}.map")
+    env.Append(LINKFLAGS=["-Wl,-Map," + map_path])
+    nm = env.subst("$CC").replace("gcc", "nm")
+    min_free = int(env.GetProjectOption("custom_min_free_ram", "0"))
+    ram_size = int(env.BoardConfig().get("upload.maximum_ram_size", RAM_SIZE))
+
+    def action(target, source, env):
+        elf = str(target[0])
+        text, free = report(map_path, elf, nm, ram_size)
+        with open(os.path.join(os.path.dirname(elf), "memory_report.txt"), "w") as f:
+            f.write(text + "\n")
+        print(text)
+        if free < min_free:
+            sys.stderr.write("Static RAM leaves %d bytes, custom_min_free_ram is %d\n" % (free, min_free))
+            env.Exit(1)
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", action)
+
+
+try:
+    Import("env")  # noqa: F821, defined when run by PlatformIO
+except NameError:
+    if __name__ == "__main__":
+        sys.exit(main())
+else:
+    pio_post_link(env)  # noqa: F821
@@ -0,0 +1,83 @@
+#pragma once
+// Arduino API for the native (Linux) build of the firmware, see native.cpp
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <stddef.h>
+#include <avr/pgmspace.h>
+#include <avr/io.h>
+
+// per task timing for trace replays, see native.cpp
+#define SCHEDULER_HOOKS
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define LED_BUILTIN 13
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define HEX 16
+#define DEC 10
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define noInterrupts()
+#define interrupts()
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+        for (size_t i = 0; i < size; i++) write(buffer[i]);
+        return size;
+    }
+
+    size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+    size_t print(const __FlashStringHelper *s) { return print((const char *)s); }
+    size_t print(char c) { return write(c); }
+    size_t print(long n, int base = DEC) { return format(base == HEX ? "%lx" : "%ld", n); }
+    size_t print(unsigned long n, int base = DEC) { return format(base == HEX ? "%lx" : "%lu", n); }
+    size_t print(int n, int base = DEC) { return print((long)n, base); }
+    size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(double n, int digits = 2) { return format("%.*f", digits, n); }
+    template <class T> size_t println(T value) { return print(value) + println(); }
+    template <class T> size_t println(T value, int base) { return print(value, base) + println(); }
+    size_t println(void) { return print("\r\n"); }
+
+private:
+    template <class... Args> size_t format(const char *format, Args... args)
+    {
+        char text[32];
+        snprintf(text, sizeof(text), format, args...);
+        return print((const char *)text);
+    }
+};
@@ -0,0 +1,22 @@
+#pragma once
+#include <OneWire.h>
+
+// Simulated DS18B20s on one bus, see OneWire.h.
+
+typedef uint8_t DeviceAddress[8];
+
+#define DEVICE_DISCONNECTED_C -127
+
+class DallasTemperature
+{
+public:
+    DallasTemperature(OneWire *) {}
+    void begin(void) {}
+    void setWaitForConversion(bool) {}
+    void requestTemperatures(void) {}
+
+    bool readScratchPad(const uint8_t *address, uint8_t *scratchPad)
+    {
+        return nativeScratchpad(address[1], scratchPad);
+    }
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include <Arduino.h>
+
+// 1 KB EEPROM, kept in the file named by FAN_EEPROM when set
+class EEPROMClass
+{
+public:
+    uint8_t read(int address);
+    void write(int address, uint8_t value);
+    void update(int address, uint8_t value) { if (read(address) != value) write(address, value); }
+
+    template <class T> T &get(int address, T &value)
+    {
+        uint8_t *p = (uint8_t *)&value;
+        for (size_t i = 0; i < sizeof(T); i++) p[i] = read(address + i);
+        return value;
+    }
+
+    template <class T> const T &put(int address, const T &value)
+    {
+        const uint8_t *p = (const uint8_t *)&value;
+        for (size_t i = 0; i < sizeof(T); i++) update(address + i, p[i]);
+        return value;
+    }
+};
+
+extern EEPROMClass EEPROM;
@@ -0,0 +1,57 @@
+#pragma once
+#include <Arduino.h>
+
+// Simulated OneWire buses, see native.cpp: sensor n sits on bus n modulo the
+// number of buses, as ROM 28 n 00 00 00 00 00 crc. The search leaves out the
+// missing ones.
+
+uint8_t nativeSensorCount(void);
+float nativeTemperature(uint8_t sensor);
+uint8_t nativeBus(uint8_t pin);
+uint8_t nativeBusCount(void);
+bool nativeScratchpad(uint8_t sensor, uint8_t *scratchpad);
+
+class OneWire
+{
+    uint8_t bus = 0;
+    uint8_t next = 0;
+
+public:
+    OneWire() {}
+    OneWire(uint8_t pin) { begin(pin); }
+    void begin(uint8_t pin) { bus = nativeBus(pin); }
+    void reset_search(void) { next = 0; }
+
+    uint8_t search(uint8_t *rom, bool = true)
+    {
+        for (; next < nativeSensorCount(); next++) {
+            if (next % nativeBusCount() != bus || nativeTemperature(next) == -127) continue;
+            nativeRom(next++, rom);
+            return 1;
+        }
+        return 0;
+    }
+
+    static void nativeRom(uint8_t sensor, uint8_t *rom)
+    {
+        memset(rom, 0, 8);
+        rom[0] = 0x28;
+        rom[1] = sensor;
+        rom[7] = crc8(rom, 7);
+    }
+
+    static uint8_t crc8(const uint8_t *addr, uint8_t len)
+    {
+        uint8_t crc = 0;
+        while (len--) {
+            uint8_t in = *addr++;
+            for (uint8_t i = 8; i; i--) {
+                uint8_t mix = (crc ^ in) & 0x01;
+                crc >>= 1;
+                if (mix) crc ^= 0x8c;
+                in >>= 1;
+            }
+        }
+        return crc;
+    }
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <Arduino.h>
+
+// RtuFramer for the native build: the bus is a pseudo terminal, the path of
+// its slave side is printed at start. Frames end after a 3.5 character gap,
+// as on the wire.
+
+class RtuFramerClass : public Print
+{
+    int fd = -1;
+    uint8_t frame[256];
+    uint16_t length = 0;
+    unsigned long lastByteUs = 0;
+    unsigned long gapUs = 0;
+    unsigned long closedUs = 0;
+    uint16_t dropped = 0;
+
+    void fill(void);
+
+public:
+    void begin(unsigned long baud, uint8_t dePin);
+    uint8_t available(void);
+    uint8_t receive(uint8_t *buffer, uint8_t size);
+    bool send(const uint8_t *data, uint8_t length);
+    bool busy(void) { return false; }
+    uint32_t frameMicros(void) { return closedUs; }
+    uint16_t droppedFrames(void) { return dropped; }
+    size_t write(uint8_t c) override;
+
+    // wait for a byte from the bus for at most timeoutUs
+    void waitForInput(unsigned long timeoutUs);
+    const char *path(void);
+};
+
+extern RtuFramerClass RtuFramer;
@@ -0,0 +1,11 @@
+#pragma once
+#include <stdint.h>
+#define E2END 0x3FF
+#define RAMEND 0x8FF
+#define PORF 0
+#define EXTRF 1
+#define BORF 2
+#define WDRF 3
+#ifndef _BV
+#define _BV(bit) (1 << (bit))
+#endif
@@ -0,0 +1,6 @@
+#pragma once
+#include <string.h>
+#define PROGMEM
+#define memcpy_P memcpy
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
@@ -0,0 +1,5 @@
+#pragma once
+#define SLEEP_MODE_IDLE 0
+// idle sleep waits for the next byte from the bus, for at most a timer0 tick
+void sleep_mode(void);
+inline void set_sleep_mode(int) {}
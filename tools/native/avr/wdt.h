@@ -0,0 +1,7 @@
+#pragma once
+#define WDTO_15MS 0
+#define WDTO_2S 7
+// the native build has no watchdog, loop() stalls just hang
+inline void wdt_enable(int) {}
+inline void wdt_reset(void) {}
+inline void wdt_disable(void) {}
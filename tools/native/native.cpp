@@ -0,0 +1,793 @@
+// Native (Linux) build of the firmware: the Arduino core, EEPROM, sensors and
+// the RS485 bus are emulated, everything in src/ and lib/ runs unchanged.
+//
+//   FAN_EEPROM=file    keep the EEPROM in file, across runs and resets
+//   FAN_ADDRESS=n      slave address to start with on a blank EEPROM
+//   FAN_SENSORS=n      number of sensors, 2 by default
+//   FAN_TEMPS=a,b,...  fixed temperatures instead of the built-in profile,
+//                      -127 for a missing sensor
+//   FAN_TEMPS=@file    the same, read from file at every reading
+//   FAN_CRC_ERRORS=n   corrupt every nth scratchpad read
+//   FAN_LOAD=watts     an enclosure heated by watts and cooled by the fans
+//   FAN_AMBIENT=c      its ambient temperature, 22 C by default
+//   FAN_RECORD=file    write a trace of the run to file, up to the first reset
+//   FAN_REPLAY=file    run against a trace on a virtual clock instead, then
+//                      compare the outputs and report the time per task
+//
+// The bus is a pseudo terminal; "pty <path>" on stdout names its slave side.
+// A reset (a crash or resetRecordRestart()) restarts the process on the same
+// terminal.
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <RtuFramer.h>
+#include <MemoryStats.h>
+#include <ResetRecord.h>
+#include <OneWireBank.h>
+#include "Boards.h"
+#include "FanController.h"
+#include "../sim/ThermalModel.h"
+
+#ifndef BOARD_CONFIG
+#define BOARD_CONFIG SingleFanBoard
+#endif
+
+void setup(void);
+void loop(void);
+
+EEPROMClass EEPROM;
+RtuFramerClass RtuFramer;
+ResetRecord resetRecord;
+
+static char **arguments;
+static bool restarted;
+static uint8_t pwm[20];
+static bool replaying;
+static unsigned long long virtualUs;
+
+static void replayAdvance(unsigned long long us);
+
+// --- time -------------------------------------------------------------------
+
+static unsigned long long monotonicUs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+static unsigned long long startUs = monotonicUs();
+
+// us since start, on the virtual clock during a replay
+static unsigned long long nowUs(void)
+{
+    return replaying ? virtualUs : monotonicUs() - startUs;
+}
+
+// both wrap at 32 bits, as on the AVR; a replay charges a microsecond per
+// call, so busy waits end
+unsigned long micros(void)
+{
+    if (replaying) replayAdvance(1);
+    return (uint32_t)nowUs();
+}
+
+unsigned long millis(void)
+{
+    return (uint32_t)(nowUs() / 1000);
+}
+
+void delay(unsigned long ms)
+{
+    if (replaying) replayAdvance(ms * 1000ULL);
+    else usleep(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    if (replaying) replayAdvance(us);
+    else usleep(us);
+}
+
+void sleep_mode(void)
+{
+    RtuFramer.waitForInput(1000);
+}
+
+// --- trace ------------------------------------------------------------------
+//
+// One event per line, us since start first; # starts a comment line:
+//
+//   <us> E <hex>           EEPROM contents at start
+//   <us> T <sensor> <C>    reading of a sensor from then on, -127 missing
+//   <us> R <hex>           frame received, as delivered to the firmware
+//   <us> S <hex>           frame sent
+//   <us> P <pin> <duty>    PWM output changed
+//   <us> X                 end of the recording, on SIGTERM or SIGINT
+//
+// E, T and R are inputs, fed to the firmware at their time during a replay.
+// S and P are outputs, compared per kind and in order with the ones the
+// replay produces. A T event carries the time halfway between the reading
+// that saw the new value and the one before, so it reaches the same reading
+// while the virtual clock stays within half a reading interval of the
+// recorded one. Without an X event the replay runs a second past the last.
+
+#define TRACE_MAX_SENSORS 16
+#define TRACE_TAIL_US 1000000ULL    // replayed past the last event
+#define TRACE_MAX_DIFFS 10
+#define TRACE_MAX_TASKS 16
+
+struct TraceEvent
+{
+    unsigned long long us;
+    char type;
+    std::string data;       // the rest of the line
+};
+
+static FILE *recordFile;
+static const char *replayPath;
+static std::vector<TraceEvent> temperatureEvents, frameEvents, expected, produced;
+static size_t nextTemperature, nextFrame;
+static std::vector<uint8_t> replayEeprom;
+static float replayTemps[TRACE_MAX_SENSORS];
+static uint8_t replaySensors;
+static unsigned long long replayEndUs;
+static bool replayEnd;
+
+// host time spent in each scheduler task
+static struct {
+    uint32_t runs;
+    unsigned long long startNs;
+    unsigned long long totalNs;
+    unsigned long long maxNs;
+} taskTimes[TRACE_MAX_TASKS];
+
+static unsigned long long monotonicNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void schedulerTaskStart(uint8_t index)
+{
+    if (index < TRACE_MAX_TASKS) taskTimes[index].startNs = monotonicNs();
+}
+
+void schedulerTaskEnd(uint8_t index)
+{
+    if (index >= TRACE_MAX_TASKS) return;
+    auto &t = taskTimes[index];
+    unsigned long long ns = monotonicNs() - t.startNs;
+    t.runs++;
+    t.totalNs += ns;
+    t.maxNs = max(t.maxNs, ns);
+}
+
+static std::string traceHex(const uint8_t *data, size_t length)
+{
+    std::string text;
+    char digits[3];
+    for (size_t i = 0; i < length; i++) {
+        snprintf(digits, sizeof(digits), "%02x", data[i]);
+        text += digits;
+    }
+    return text;
+}
+
+static std::vector<uint8_t> traceBytes(const std::string &text)
+{
+    std::vector<uint8_t> bytes;
+    for (size_t i = 0; i + 1 < text.size(); i += 2) {
+        bytes.push_back(strtoul(text.substr(i, 2).c_str(), 0, 16));
+    }
+    return bytes;
+}
+
+static void traceEvent(char type, const std::string &data)
+{
+    unsigned long long us = nowUs();
+    if (replaying && (type == 'S' || type == 'P')) produced.push_back({ us, type, data });
+    if (recordFile) fprintf(recordFile, "%llu %c %s\n", us, type, data.c_str());
+}
+
+// a reading as the firmware can see it, at the sensor's 1/16 C resolution
+static void traceTemperature(uint8_t sensor, float value)
+{
+    static float last[TRACE_MAX_SENSORS];
+    static unsigned long long lastReadUs[TRACE_MAX_SENSORS];
+    static bool seen[TRACE_MAX_SENSORS];
+    if (!recordFile || sensor >= TRACE_MAX_SENSORS) return;
+    if (value != DEVICE_DISCONNECTED_C) value = roundf(value * 16) / 16;
+    if (!seen[sensor] || value != last[sensor]) {
+        unsigned long long us = seen[sensor] ? (lastReadUs[sensor] + nowUs()) / 2 : 0;
+        fprintf(recordFile, "%llu T %u %.4f\n", us, sensor, value);
+        seen[sensor] = true;
+        last[sensor] = value;
+    }
+    lastReadUs[sensor] = nowUs();
+}
+
+static void onStop(int)
+{
+    fprintf(recordFile, "%llu X\n", nowUs());
+    fclose(recordFile);
+    _exit(0);
+}
+
+static void traceRecord(const char *path)
+{
+    recordFile = fopen(path, "w");
+    if (!recordFile) {
+        perror(path);
+        exit(2);
+    }
+    setvbuf(recordFile, 0, _IOLBF, 0);
+    if (!replaying) {
+        signal(SIGTERM, onStop);
+        signal(SIGINT, onStop);
+    }
+}
+
+static void traceEeprom(void)
+{
+    if (!recordFile) return;
+    uint8_t image[E2END + 1];
+    for (int i = 0; i <= E2END; i++) image[i] = EEPROM.read(i);
+    traceEvent('E', traceHex(image, sizeof(image)));
+}
+
+static void replayLoad(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        exit(2);
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), file)) {
+        TraceEvent event;
+        int offset = 0;
+        if (line[0] == '#' || sscanf(line, "%llu %c %n", &event.us, &event.type, &offset) < 2 || !offset) continue;
+        event.data = line + offset;
+        while (!event.data.empty() && isspace((unsigned char)event.data.back())) event.data.pop_back();
+        unsigned sensor;
+        switch (event.type) {
+        case 'E':
+            replayEeprom = traceBytes(event.data);
+            break;
+        case 'T':
+            if (sscanf(event.data.c_str(), "%u", &sensor) < 1 || sensor >= TRACE_MAX_SENSORS) continue;
+            replaySensors = max(replaySensors, sensor + 1);
+            temperatureEvents.push_back(event);
+            break;
+        case 'R':
+            frameEvents.push_back(event);
+            break;
+        case 'S':
+        case 'P':
+            expected.push_back(event);
+            break;
+        case 'X':
+            replayEnd = true;
+            replayEndUs = event.us;
+            continue;
+        default:
+            continue;
+        }
+        if (!replayEnd) replayEndUs = max(replayEndUs, event.us + TRACE_TAIL_US);
+    }
+    fclose(file);
+    // written at the next reading, so not always in order
+    std::stable_sort(temperatureEvents.begin(), temperatureEvents.end(), [](const TraceEvent &a, const TraceEvent &b) { return a.us < b.us; });
+    for (float &t : replayTemps) t = DEVICE_DISCONNECTED_C;
+    replayPath = path;
+    replaying = true;
+    replayAdvance(0);
+}
+
+// compare the outputs of one kind; the number that differ
+static unsigned replayCompare(char type, unsigned long long &maxOffsetUs)
+{
+    std::vector<const TraceEvent *> want, got;
+    for (const auto &e : expected) if (e.type == type) want.push_back(&e);
+    for (const auto &e : produced) if (e.type == type) got.push_back(&e);
+    unsigned differ = 0;
+    for (size_t i = 0; i < max(want.size(), got.size()); i++) {
+        const TraceEvent *w = i < want.size() ? want[i] : 0;
+        const TraceEvent *g = i < got.size() ? got[i] : 0;
+        if (w && g && w->data == g->data) {
+            maxOffsetUs = max(maxOffsetUs, w->us > g->us ? w->us - g->us : g->us - w->us);
+            continue;
+        }
+        if (differ++ >= TRACE_MAX_DIFFS) continue;
+        printf("%c #%zu: expected %s %s, produced %s %s\n", type, i,
+               w ? std::to_string(w->us).c_str() : "-", w ? w->data.c_str() : "",
+               g ? std::to_string(g->us).c_str() : "-", g ? g->data.c_str() : "");
+    }
+    return differ;
+}
+
+static void replayFinish(const char *why)
+{
+    unsigned long long maxOffsetUs = 0;
+    unsigned differ = replayCompare('S', maxOffsetUs) + replayCompare('P', maxOffsetUs);
+    printf("replay %s: %s at %llu us, %zu outputs expected, %zu produced, %u differ, max offset %llu us\n",
+           replayPath, why, virtualUs, expected.size(), produced.size(), differ, maxOffsetUs);
+    printf("task  runs   total us  mean us  max us\n");
+    for (uint8_t i = 0; i < TRACE_MAX_TASKS; i++) {
+        const auto &t = taskTimes[i];
+        if (!t.runs) continue;
+        printf("%4u %6u %10.0f %8.1f %7.1f\n", i, t.runs, t.totalNs / 1e3, t.totalNs / 1e3 / t.runs, t.maxNs / 1e3);
+    }
+    fflush(stdout);
+    if (recordFile) {
+        fprintf(recordFile, "%llu X\n", virtualUs);
+        fclose(recordFile);
+    }
+    exit(differ ? 1 : 0);
+}
+
+// move the virtual clock on, taking the sensor readings it passes
+static void replayAdvance(unsigned long long us)
+{
+    virtualUs = min(virtualUs + us, replayEndUs);
+    while (nextTemperature < temperatureEvents.size() && temperatureEvents[nextTemperature].us <= virtualUs) {
+        unsigned sensor;
+        float value;
+        if (sscanf(temperatureEvents[nextTemperature++].data.c_str(), "%u %f", &sensor, &value) == 2) {
+            replayTemps[sensor] = value;
+        }
+    }
+    if (virtualUs >= replayEndUs) replayFinish("end of trace");
+}
+
+// --- pins -------------------------------------------------------------------
+
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t, uint8_t) {}
+
+int digitalRead(uint8_t)
+{
+    return LOW;
+}
+
+void analogWrite(uint8_t pin, int value)
+{
+    if (pin >= sizeof(pwm)) return;
+    if (pwm[pin] != value) traceEvent('P', std::to_string(pin) + " " + std::to_string(value));
+    pwm[pin] = value;
+}
+
+// --- sensors ----------------------------------------------------------------
+
+uint8_t nativeSensorCount(void)
+{
+    if (replaying) return replaySensors;
+    const char *count = getenv("FAN_SENSORS");
+    return count ? atoi(count) : 2;
+}
+
+
+// the thermal model of tools/sim under a fixed load, cooled by the fastest
+// fan
+struct Enclosure
+{
+    ThermalModel model;
+    double load = 0;            // W
+    unsigned long long lastUs = 0;
+
+    double temperature(unsigned long long nowUs)
+    {
+        uint8_t duty = 0;
+        for (uint8_t value : pwm) duty = max(duty, value);
+        double elapsed = lastUs ? (nowUs - lastUs) / 1e6 : 0;
+        lastUs = nowUs;
+        // 1 s steps, far below the time constant of half a minute and more
+        while (elapsed > 0) {
+            double dt = min(elapsed, 1.0);
+            model.step(dt, load, duty / 255.0);
+            elapsed -= dt;
+        }
+        return model.air;
+    }
+};
+
+static Enclosure *enclosure(void)
+{
+    static Enclosure current;
+    static bool used = getenv("FAN_LOAD") != 0;
+    if (!used) return 0;
+    if (!current.lastUs) {
+        const char *ambient = getenv("FAN_AMBIENT");
+        if (ambient) current.model.settle(atof(ambient));
+        current.load = atof(getenv("FAN_LOAD"));
+    }
+    return &current;
+}
+
+// FAN_TEMPS, the enclosure or a slow swing around 28 C, one degree apart per
+// sensor
+static float sourceTemperature(uint8_t sensor)
+{
+    const char *temps = getenv("FAN_TEMPS");
+    static char list[256];
+    if (temps && temps[0] == '@') {
+        // read again every time, so sensors can be plugged in and out
+        FILE *file = fopen(temps + 1, "r");
+        list[0] = 0;
+        if (file) {
+            if (!fgets(list, sizeof(list), file)) list[0] = 0;
+            fclose(file);
+        }
+        temps = list;
+    }
+    if (temps) {
+        for (uint8_t i = 0; i < sensor && temps; i++) {
+            temps = strchr(temps, ',');
+            if (temps) temps++;
+        }
+        return temps ? atof(temps) : DEVICE_DISCONNECTED_C;
+    }
+    Enclosure *model = enclosure();
+    if (model) return model->temperature(monotonicUs()) + sensor * 0.5;
+    return 28 + sensor + 4 * sin(2 * M_PI * millis() / 300000.0);
+}
+
+float nativeTemperature(uint8_t sensor)
+{
+    float value;
+    if (replaying) value = sensor < replaySensors ? replayTemps[sensor] : DEVICE_DISCONNECTED_C;
+    else value = sourceTemperature(sensor);
+    traceTemperature(sensor, value);
+    return value;
+}
+
+// a DS18B20 scratchpad at 12-bit resolution; FAN_CRC_ERRORS=n corrupts every
+// nth one
+bool nativeScratchpad(uint8_t sensor, uint8_t *scratchpad)
+{
+    static const char *every = getenv("FAN_CRC_ERRORS");
+    static unsigned reads;
+    float temperature = nativeTemperature(sensor);
+    if (temperature == DEVICE_DISCONNECTED_C) return false;
+    int16_t raw = roundf(temperature * 16);
+    memset(scratchpad, 0, DS18_SCRATCHPAD_SIZE);
+    scratchpad[0] = raw;
+    scratchpad[1] = raw >> 8;
+    scratchpad[4] = 0x7f;
+    scratchpad[5] = 0xff;
+    scratchpad[7] = 0x10;
+    scratchpad[8] = OneWire::crc8(scratchpad, 8);
+    if (every && atoi(every) > 0 && ++reads % atoi(every) == 0) scratchpad[0] ^= 0x04;
+    return true;
+}
+
+uint8_t nativeBus(uint8_t pin)
+{
+    for (uint8_t bus = 0; bus < BOARD_CONFIG::oneWireBuses; bus++) {
+        if (BOARD_CONFIG::oneWirePins[bus] == pin) return bus;
+    }
+    return 0;
+}
+
+uint8_t nativeBusCount(void)
+{
+    return BOARD_CONFIG::oneWireBuses;
+}
+
+// OneWireBank at the byte level: each bus follows the ROM and function
+// commands the DS18B20s would see
+enum BusState : uint8_t { BUS_ROM_COMMAND, BUS_MATCH_ROM, BUS_FUNCTION, BUS_SCRATCHPAD };
+
+static struct {
+    BusState state;
+    uint8_t rom[8];
+    uint8_t romLength;
+    uint8_t scratchpad[DS18_SCRATCHPAD_SIZE];
+    uint8_t readLength;
+} buses[ONE_WIRE_BANK_MAX_BUSES];
+
+static void busWrite(uint8_t bus, uint8_t value)
+{
+    auto &b = buses[bus];
+    switch (b.state) {
+    case BUS_ROM_COMMAND:
+        if (value == DS18_MATCH_ROM) {
+            b.romLength = 0;
+            b.state = BUS_MATCH_ROM;
+        } else if (value == DS18_SKIP_ROM) {
+            b.rom[0] = 0;
+            b.state = BUS_FUNCTION;
+        }
+        break;
+    case BUS_MATCH_ROM:
+        b.rom[b.romLength++] = value;
+        if (b.romLength == 8) b.state = BUS_FUNCTION;
+        break;
+    case BUS_FUNCTION:
+        // conversions are instant here, DS18_CONVERT needs nothing
+        if (value == DS18_READ_SCRATCHPAD) {
+            uint8_t sensor = b.rom[1];
+            uint8_t rom[8];
+            OneWire::nativeRom(sensor, rom);
+            memset(b.scratchpad, 0xff, sizeof(b.scratchpad));
+            if (b.rom[0] && !memcmp(rom, b.rom, 8) && sensor % nativeBusCount() == bus) nativeScratchpad(sensor, b.scratchpad);
+            b.readLength = 0;
+            b.state = BUS_SCRATCHPAD;
+        }
+        break;
+    case BUS_SCRATCHPAD:
+        break;
+    }
+}
+
+void OneWireBank::begin(const uint8_t *, uint8_t count)
+{
+    this->count = min(count, ONE_WIRE_BANK_MAX_BUSES);
+}
+
+uint8_t OneWireBank::reset(uint8_t mask)
+{
+    uint8_t present = 0;
+    for (uint8_t bus = 0; bus < count; bus++) {
+        if (!(mask & (1 << bus))) continue;
+        buses[bus].state = BUS_ROM_COMMAND;
+        for (uint8_t sensor = bus; sensor < nativeSensorCount(); sensor += count) {
+            if (nativeTemperature(sensor) != DEVICE_DISCONNECTED_C) present |= 1 << bus;
+        }
+    }
+    return present;
+}
+
+void OneWireBank::write(uint8_t mask, uint8_t value)
+{
+    for (uint8_t bus = 0; bus < count; bus++) {
+        if (mask & (1 << bus)) busWrite(bus, value);
+    }
+}
+
+void OneWireBank::write(uint8_t mask, const uint8_t *bytes)
+{
+    for (uint8_t bus = 0; bus < count; bus++) {
+        if (mask & (1 << bus)) busWrite(bus, bytes[bus]);
+    }
+}
+
+void OneWireBank::read(uint8_t mask, uint8_t *bytes)
+{
+    for (uint8_t bus = 0; bus < count; bus++) {
+        if (!(mask & (1 << bus))) continue;
+        auto &b = buses[bus];
+        bytes[bus] = b.state == BUS_SCRATCHPAD && b.readLength < DS18_SCRATCHPAD_SIZE ? b.scratchpad[b.readLength++] : 0xff;
+    }
+}
+
+// --- EEPROM -----------------------------------------------------------------
+
+static uint8_t eeprom[E2END + 1];
+static int eepromFd = -2;
+
+static void eepromOpen(void)
+{
+    if (eepromFd != -2) return;
+    memset(eeprom, 0xff, sizeof(eeprom));
+    if (replaying) {
+        // the trace's image, never written back
+        memcpy(eeprom, replayEeprom.data(), min(replayEeprom.size(), sizeof(eeprom)));
+        eepromFd = -1;
+        return;
+    }
+    const char *path = getenv("FAN_EEPROM");
+    eepromFd = path ? open(path, O_RDWR | O_CREAT, 0644) : -1;
+    if (eepromFd >= 0 && pread(eepromFd, eeprom, sizeof(eeprom), 0) < (ssize_t)sizeof(eeprom)) {
+        pwrite(eepromFd, eeprom, sizeof(eeprom), 0);
+    }
+}
+
+uint8_t EEPROMClass::read(int address)
+{
+    eepromOpen();
+    return eeprom[address & E2END];
+}
+
+void EEPROMClass::write(int address, uint8_t value)
+{
+    eepromOpen();
+    eeprom[address & E2END] = value;
+    if (eepromFd >= 0) pwrite(eepromFd, &value, 1, address & E2END);
+}
+
+// --- memory and reset records ----------------------------------------------
+
+// nothing to measure on the host
+uint16_t memoryStackHeadroom(void)
+{
+    return 0;
+}
+
+uint16_t memoryFree(void)
+{
+    return 0;
+}
+
+// RAM does not survive a restart here: resetRecordRestart() reads as the
+// watchdog reset it is on the AVR, a crash as a reset without any MCUSR flag
+void resetRecordBegin(ResetReport &report)
+{
+    bool requested = getenv("FAN_RESTART") != 0;
+    unsetenv("FAN_RESTART");
+    report.cause = restarted ? (requested ? _BV(WDRF) : 0) : _BV(PORF);
+    report.task = requested ? RESET_RECORD_RESTART : RESET_RECORD_IDLE;
+    report.function = 0;
+    report.loops = 0;
+    report.resets = restarted ? 1 : 0;
+    resetRecord.magic = RESET_RECORD_MAGIC;
+    resetRecord.task = RESET_RECORD_IDLE;
+    resetRecord.function = 0;
+    resetRecord.loops = 0;
+    resetRecord.resets = report.resets;
+}
+
+static void onReset(int)
+{
+    if (replaying) replayFinish("reset");
+    // the trace ends here, the restarted process does not record
+    if (recordFile) {
+        fprintf(recordFile, "# reset at %llu us\n", nowUs());
+        fclose(recordFile);
+        unsetenv("FAN_RECORD");
+    }
+    execv("/proc/self/exe", arguments);
+    _exit(1);
+}
+
+void resetRecordRestart(void)
+{
+    setenv("FAN_RESTART", "1", 1);
+    onReset(0);
+}
+
+// --- bus --------------------------------------------------------------------
+
+void RtuFramerClass::begin(unsigned long baud, uint8_t)
+{
+    // 11 bits per character, 1750 us above 19200 baud as on the AVR
+    gapUs = baud > 19200 ? 1750 : 11000000UL * 7 / 2 / baud;
+    if (replaying) return;
+
+    const char *inherited = getenv("FAN_PTY_FD");
+    if (inherited) {
+        fd = atoi(inherited);
+    } else {
+        fd = posix_openpt(O_RDWR | O_NOCTTY);
+        if (fd < 0 || grantpt(fd) || unlockpt(fd)) {
+            perror("pty");
+            exit(1);
+        }
+        // raw, and kept open so the master never sees a hang-up
+        int slave = open(ptsname(fd), O_RDWR | O_NOCTTY);
+        struct termios tio;
+        tcgetattr(slave, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(slave, TCSANOW, &tio);
+        char value[16];
+        snprintf(value, sizeof(value), "%d", fd);
+        setenv("FAN_PTY_FD", value, 1);
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    printf("pty %s\n", ptsname(fd));
+    fflush(stdout);
+}
+
+void RtuFramerClass::fill(void)
+{
+    if (replaying) {
+        // a recorded frame arrives a gap before it was delivered
+        if (length || nextFrame >= frameEvents.size() || frameEvents[nextFrame].us > nowUs() + gapUs) return;
+        const TraceEvent &event = frameEvents[nextFrame++];
+        std::vector<uint8_t> bytes = traceBytes(event.data);
+        length = min(bytes.size(), sizeof(frame));
+        memcpy(frame, bytes.data(), length);
+        lastByteUs = event.us - gapUs;
+        return;
+    }
+    uint8_t buffer[64];
+    ssize_t n;
+    while ((n = ::read(fd, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            if (length < sizeof(frame)) frame[length++] = buffer[i];
+        }
+        lastByteUs = micros();
+    }
+}
+
+uint8_t RtuFramerClass::available(void)
+{
+    fill();
+    return length && micros() - lastByteUs >= gapUs ? 1 : 0;
+}
+
+uint8_t RtuFramerClass::receive(uint8_t *buffer, uint8_t size)
+{
+    if (!available()) return 0;
+    uint8_t n = length;
+    length = 0;
+    closedUs = lastByteUs + gapUs;
+    if (n > size) {
+        dropped++;
+        return 0;
+    }
+    memcpy(buffer, frame, n);
+    if (recordFile) traceEvent('R', traceHex(buffer, n));
+    return n;
+}
+
+bool RtuFramerClass::send(const uint8_t *data, uint8_t length)
+{
+    traceEvent('S', traceHex(data, length));
+    if (replaying) return true;
+    return ::write(fd, data, length) == length;
+}
+
+size_t RtuFramerClass::write(uint8_t c)
+{
+    return ::write(fd, &c, 1) == 1;
+}
+
+void RtuFramerClass::waitForInput(unsigned long timeoutUs)
+{
+    // a frame in progress completes by the gap alone
+    if (length) timeoutUs = min(timeoutUs, gapUs);
+    if (replaying) {
+        // up to the next recorded frame, and at least a microsecond
+        unsigned long long until = nowUs() + timeoutUs;
+        if (nextFrame < frameEvents.size()) until = min(until, frameEvents[nextFrame].us - gapUs);
+        replayAdvance(until > nowUs() ? until - nowUs() : 1);
+        return;
+    }
+    struct pollfd p = { fd, POLLIN, 0 };
+    poll(&p, 1, (timeoutUs + 999) / 1000);
+}
+
+// --- main -------------------------------------------------------------------
+
+// a blank EEPROM gets the firmware defaults (setConfigDefaults()) with the
+// address from FAN_ADDRESS, so a fleet can start with distinct addresses
+static void seedConfig(void)
+{
+    const char *address = getenv("FAN_ADDRESS");
+    Config cfg;
+    EEPROM.get(0, cfg);
+    if (!address || strncmp(cfg.hash, CONFIG_HASH, sizeof(cfg.hash)) == 0) return;
+    memset(&cfg, 0, sizeof(cfg));
+    strcpy(cfg.hash, CONFIG_HASH);
+    cfg.tempThreshold = 30;
+    cfg.tempHysteresis = 5;
+    cfg.modbusSlaveAddr = atoi(address);
+    EEPROM.put(0, cfg);
+}
+
+int main(int, char **argv)
+{
+    arguments = argv;
+    restarted = getenv("FAN_PTY_FD") != 0;
+    signal(SIGSEGV, onReset);
+    const char *replay = getenv("FAN_REPLAY");
+    const char *record = getenv("FAN_RECORD");
+    if (replay) replayLoad(replay);
+    if (record && !restarted) traceRecord(record);
+    if (!replay) seedConfig();
+    traceEeprom();
+    setup();
+    for (;;) loop();
+}
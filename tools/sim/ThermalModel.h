@@ -0,0 +1,32 @@
+#pragma once
+// Lumped thermal model of an enclosure: one air mass heated by a load and
+// cooled by natural convection plus the fans' forced airflow, and a probe
+// that follows the air with a first order lag. Shared by tools/sim and the
+// native build's FAN_LOAD enclosure.
+
+struct ThermalModel
+{
+    double ambient = 22.0;      // C
+    double capacity = 1200.0;   // J/K of air, boards and sheet metal
+    double natural = 4.0;       // W/K with the fans stopped
+    double forced = 30.0;       // W/K added at full fan speed
+    double sensorLag = 30.0;    // s, probe and its mounting
+
+    double air = ambient;
+    double probe = ambient;
+
+    // start from ambient, at a different ambient than the default
+    void settle(double temperature)
+    {
+        ambient = air = probe = temperature;
+    }
+
+    // advance by dt seconds, with load in W and airflow from 0 (fans stopped)
+    // to 1 (full speed); dt should stay well below the sensor lag
+    void step(double dt, double load, double airflow)
+    {
+        double loss = (natural + forced * airflow) * (air - ambient);
+        air += (load - loss) / capacity * dt;
+        probe += (air - probe) / sensorLag * dt;
+    }
+};
@@ -0,0 +1,160 @@
+// Host simulation of an enclosure under a step load, driven by the same
+// control law as the firmware (lib/FanControl). Runs the scenario without
+// and with feed-forward and compares peak temperature and fan energy. With
+// -t it first runs the relay autotune under full load, as the firmware does,
+// and compares the tuned settings with the given ones.
+//
+//   g++ -std=c++17 -O2 -Ilib/FanControl tools/sim/thermal_sim.cpp -o thermal_sim
+//   ./thermal_sim [look-ahead seconds] [threshold] [hysteresis]
+//   ./thermal_sim -t [threshold] [hysteresis]
+
+#include <FanControl.h>
+#include "ThermalModel.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PWM_MIN_DUTY_CYCLE 25
+#define PWM_MAX_DUTY_CYCLE 255
+#define READ_INTERVAL_MS 750
+#define ADJUST_INTERVAL_MS 1000
+#define STEP_MS 50
+#define AUTOTUNE_LIMIT 1000
+#define AUTOTUNE_TIMEOUT 7200000UL
+
+// the enclosure under a load profile, as the firmware's sensor reads it
+struct Plant
+{
+    ThermalModel enclosure;
+    double fanPower = 5.0;      // W at full speed
+    double fixedLoad = 0;       // W, 0 for the step profile
+
+    // load in W over time: idle, a step to full load, back to idle
+    double load(double t) const
+    {
+        if (fixedLoad) return fixedLoad;
+        return t >= 60 && t < 900 ? 250.0 : 40.0;
+    }
+
+    void step(double t, double dt, uint8_t dutyCycle)
+    {
+        enclosure.step(dt, load(t), dutyCycle / 255.0);
+    }
+
+    double air() const
+    {
+        return enclosure.air;
+    }
+
+    // DS18B20 at 12 bit resolution reports 1/16 C steps
+    int16_t reading() const
+    {
+        return (int16_t)lround(floor(enclosure.probe * 16.0) / 16.0 * 100.0);
+    }
+};
+
+struct Result
+{
+    double peak;
+    double aboveThreshold;      // s spent above the threshold
+    double fanEnergy;           // J, fan power scales with the cube of speed
+};
+
+static Result run(uint16_t lookAhead, uint8_t threshold, uint8_t hysteresis)
+{
+    Plant plant;
+    RateFilter rate;
+    int16_t temp = plant.reading();
+    uint8_t dutyCycle = 0;
+    Result result = { plant.air(), 0, 0 };
+
+    for (uint32_t now = 0; now <= 1800000; now += STEP_MS) {
+        double t = now / 1000.0;
+        double dt = STEP_MS / 1000.0;
+        plant.step(t, dt, dutyCycle);
+
+        if (now % READ_INTERVAL_MS == 0) {
+            temp = plant.reading();
+            rate.update(temp, now);
+        }
+        if (now % ADJUST_INTERVAL_MS == 0) {
+            int16_t controlTemp = temp + feedForward(rate.value(), lookAhead);
+            dutyCycle = fanDutyCycle(controlTemp, threshold, hysteresis, PWM_MIN_DUTY_CYCLE, PWM_MAX_DUTY_CYCLE);
+        }
+
+        if (plant.air() > result.peak) result.peak = plant.air();
+        if (plant.air() > threshold) result.aboveThreshold += dt;
+        result.fanEnergy += plant.fanPower * pow(dutyCycle / 255.0, 3) * dt;
+    }
+    return result;
+}
+
+// settle under full load with the given settings, then run the relay
+// experiment from the temperature reached, as a Modbus start does
+static RelayTune tune(uint8_t threshold, uint8_t hysteresis, uint32_t &duration)
+{
+    Plant plant;
+    plant.fixedLoad = 250.0;
+    RelayTune relay;
+    int16_t temp = plant.reading();
+    uint8_t dutyCycle = 0;
+    uint32_t start = 1200000;
+
+    for (uint32_t now = 0; now < start + AUTOTUNE_TIMEOUT + ADJUST_INTERVAL_MS; now += STEP_MS) {
+        plant.step(now / 1000.0, STEP_MS / 1000.0, dutyCycle);
+        if (now % READ_INTERVAL_MS == 0) temp = plant.reading();
+        if (now % ADJUST_INTERVAL_MS != 0) continue;
+        if (now < start) {
+            dutyCycle = fanDutyCycle(temp, threshold, hysteresis, PWM_MIN_DUTY_CYCLE, PWM_MAX_DUTY_CYCLE);
+            continue;
+        }
+        if (now == start) relay.start(temp, temp + AUTOTUNE_LIMIT, PWM_MAX_DUTY_CYCLE, now, AUTOTUNE_TIMEOUT);
+        dutyCycle = relay.update(temp, now);
+        if (!relay.running()) {
+            duration = (now - start) / 1000;
+            break;
+        }
+    }
+    return relay;
+}
+
+static void report(const char *name, uint8_t threshold, uint8_t hysteresis, uint16_t lookAhead)
+{
+    Result result = run(lookAhead, threshold, hysteresis);
+    printf("%-12s %5u C %6u s %10.2f %14.0f %14.0f\n", name, hysteresis, lookAhead, result.peak,
+           result.aboveThreshold, result.fanEnergy);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "-t") == 0) {
+        uint8_t threshold = argc > 2 ? atoi(argv[2]) : 30;
+        uint8_t hysteresis = argc > 3 ? atoi(argv[3]) : 5;
+        uint32_t duration = 0;
+        RelayTune relay = tune(threshold, hysteresis, duration);
+        printf("autotune: state %u after %u s, %u cycles, amplitude %.2f C, ultimate gain %u/C, period %u s\n",
+               relay.state, duration, relay.cycles, relay.amplitude / 100.0, relay.ultimateGain, relay.ultimatePeriod);
+        if (relay.state != RELAY_TUNE_DONE) return 1;
+
+        printf("threshold %u C, 250 W step at 60 s\n", threshold);
+        printf("%-12s %7s %8s %10s %14s %14s\n", "", "hyst", "ahead", "peak C", "above thr s", "fan energy J");
+        report("given", threshold, hysteresis, 0);
+        report("tuned", threshold, relayTuneHysteresis(relay.ultimateGain, PWM_MIN_DUTY_CYCLE, PWM_MAX_DUTY_CYCLE),
+               relayTuneLookAhead(relay.ultimatePeriod));
+        return 0;
+    }
+
+    uint16_t lookAhead = argc > 1 ? atoi(argv[1]) : 30;
+    uint8_t threshold = argc > 2 ? atoi(argv[2]) : 30;
+    uint8_t hysteresis = argc > 3 ? atoi(argv[3]) : 5;
+
+    Result off = run(0, threshold, hysteresis);
+    Result on = run(lookAhead, threshold, hysteresis);
+
+    printf("threshold %u C, hysteresis %u C, 250 W step at 60 s\n", threshold, hysteresis);
+    printf("%-24s %10s %14s %14s\n", "", "peak C", "above thr s", "fan energy J");
+    printf("%-24s %10.2f %14.0f %14.0f\n", "feed-forward off", off.peak, off.aboveThreshold, off.fanEnergy);
+    printf("feed-forward %4u s      %10.2f %14.0f %14.0f\n", lookAhead, on.peak, on.aboveThreshold, on.fanEnergy);
+    return 0;
+}